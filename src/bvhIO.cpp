@@ -0,0 +1,359 @@
+#include "bvhIO.h"
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <charconv>
+#include <string_view>
+#include "glm/gtx/euler_angles.hpp"
+#include "glm/gtx/quaternion.hpp"
+
+namespace {
+
+// Reads a file through a fixed-size window, one whitespace-separated token at a time
+//
+class TokenStream {
+public:
+	TokenStream() : buffer(1 << 20) { p = end = buffer.data(); }
+	~TokenStream() { if (file != NULL) fclose(file); }
+
+	bool open(const std::string &path) {
+		file = fopen(path.c_str(), "rb");
+		if (file == NULL) return false;
+		if (fseek(file, 0, SEEK_END) == 0) {
+			long length = ftell(file);
+			if (length > 0) size = (uint64_t)length;
+		}
+		rewind(file);
+		return true;
+	}
+
+	uint64_t fileSize() const { return size; }
+
+	// Valid until the next call; empty at the end of the file
+	std::string_view token() {
+		for (;;) {
+			while (p < end && isspace((unsigned char)*p)) {
+				if (*p == '\n') line++;
+				p++;
+			}
+			const char *start = p;
+			while (p < end && !isspace((unsigned char)*p)) p++;
+			if (p < end || eof) return std::string_view(start, p - start);
+			p = start; // ran off the window (maybe mid-token): slide it along and read more
+			refill();
+		}
+	}
+
+	bool number(float &value) {
+		std::string_view t = token();
+		const char *first = t.data(), *last = t.data() + t.size();
+		if (first < last && *first == '+') first++; // from_chars doesn't take a leading '+'
+		std::from_chars_result result = std::from_chars(first, last, value);
+		return result.ec == std::errc() && result.ptr == last;
+	}
+
+	bool integer(int &value) {
+		std::string_view t = token();
+		std::from_chars_result result = std::from_chars(t.data(), t.data() + t.size(), value);
+		return result.ec == std::errc() && result.ptr == t.data() + t.size();
+	}
+
+	int line = 1;
+
+private:
+	void refill() {
+		size_t kept = end - p;
+		memmove(buffer.data(), p, kept);
+		p = buffer.data();
+		end = p + kept;
+		size_t got = (kept < buffer.size()) ? fread(buffer.data() + kept, 1, buffer.size() - kept, file) : 0;
+		end += got;
+		if (got == 0) eof = true; // also stops a token longer than the window
+	}
+
+	FILE *file = NULL;
+	uint64_t size = 0;
+	std::vector<char> buffer;
+	const char *p = NULL;
+	const char *end = NULL;
+	bool eof = false;
+};
+
+enum Channel { Xposition, Yposition, Zposition, Xrotation, Yrotation, Zrotation };
+
+struct ChannelLayout {
+	std::vector<Channel> channels;
+	bool yxz = false;  // rotations already in the scene's order, no conversion needed
+};
+
+class BVHParser {
+public:
+	BVHParser(TokenStream &in_, SkeletonDesc &skeleton_, SkeletonMotion &motion_, std::string &error_)
+		: in(in_), skeleton(skeleton_), motion(motion_), error(error_) { }
+
+	bool parse() {
+		skeleton.joints.clear();
+		layouts.clear();
+		if (in.token() != "HIERARCHY") return fail("expected HIERARCHY");
+		std::string_view t = in.token();
+		if (t != "ROOT") return fail("expected ROOT");
+		while (t == "ROOT") {
+			if (!parseJoint(-1)) return false;
+			t = in.token();
+		}
+		if (t != "MOTION") return fail("expected MOTION, found '" + std::string(t) + "'");
+		if (in.token() != "Frames:" || !in.integer(motion.numFrames) || motion.numFrames < 0) return fail("expected Frames: <count>");
+		if (in.token() != "Frame" || in.token() != "Time:" || !in.number(motion.frameTime)) return fail("expected Frame Time: <seconds>");
+		return parseMotion();
+	}
+
+private:
+	bool fail(const std::string &message) {
+		error = "line " + std::to_string(in.line) + ": " + message;
+		return false;
+	}
+
+	// Everything after ROOT / JOINT up to the matching }
+	bool parseJoint(int parent) {
+		JointDesc joint;
+		joint.name = std::string(in.token());
+		joint.parent = parent;
+		if (joint.name.empty() || joint.name == "{") return fail("joint needs a name");
+		if (in.token() != "{") return fail("expected { after " + joint.name);
+		int index = (int)skeleton.joints.size();
+		skeleton.joints.push_back(joint);
+		layouts.emplace_back();
+
+		for (;;) {
+			std::string_view t = in.token();
+			if (t == "}") break;
+			else if (t == "OFFSET") {
+				glm::vec3 &offset = skeleton.joints[index].translation;
+				if (!in.number(offset.x) || !in.number(offset.y) || !in.number(offset.z)) return fail("OFFSET needs three numbers");
+			}
+			else if (t == "CHANNELS") {
+				int count;
+				if (!in.integer(count) || count < 0 || count > 6) return fail("CHANNELS needs a count from 0 to 6");
+				ChannelLayout &layout = layouts[index];
+				std::string order;
+				for (int c = 0; c < count; c++) {
+					std::string_view name = in.token();
+					static const char *names[] = { "Xposition", "Yposition", "Zposition", "Xrotation", "Yrotation", "Zrotation" };
+					int found = -1;
+					for (int n = 0; n < 6; n++) if (name == names[n]) found = n;
+					if (found < 0) return fail("unknown channel '" + std::string(name) + "'");
+					layout.channels.push_back((Channel)found);
+					if (found >= Xrotation) order += names[found][0];
+				}
+				size_t matched = 0; // any of Y, X, Z in that relative order is already Ry Rx Rz
+				for (char axis : std::string("YXZ")) if (matched < order.size() && order[matched] == axis) matched++;
+				layout.yxz = (matched == order.size());
+				numChannels += count;
+			}
+			else if (t == "JOINT") {
+				if (!parseJoint(index)) return false;
+			}
+			else if (t == "End") {
+				float ignored;
+				if (in.token() != "Site" || in.token() != "{" || in.token() != "OFFSET" ||
+					!in.number(ignored) || !in.number(ignored) || !in.number(ignored) || in.token() != "}") return fail("bad End Site");
+			}
+			else if (t.empty()) return fail("file ends inside " + skeleton.joints[index].name);
+			else return fail("unexpected '" + std::string(t) + "' in " + skeleton.joints[index].name);
+		}
+		return true;
+	}
+
+	bool parseMotion() {
+		int n = (int)skeleton.joints.size();
+		motion.numJoints = n;
+		motion.rotations.clear();
+		motion.translations.clear();
+		if (motion.numFrames > 0 && numChannels == 0) return fail("Frames: given, but no joint has any channels");
+
+		// Frames: comes from the file and may be anything; each channel value takes at
+		// least two bytes ("0 "), so the file's size bounds what's worth reserving.  A
+		// count beyond that is caught as a short frame.
+		uint64_t possibleFrames = in.fileSize() / (2 * (uint64_t)std::max(numChannels, 1));
+		size_t reserved = (size_t)std::min<uint64_t>(motion.numFrames, possibleFrames) * n;
+		motion.rotations.reserve(reserved);
+		motion.translations.reserve(reserved);
+
+		float values[6];
+		for (int frame = 0; frame < motion.numFrames; frame++) {
+			for (int j = 0; j < n; j++) {
+				const ChannelLayout &layout = layouts[j];
+				for (size_t c = 0; c < layout.channels.size(); c++) {
+					if (!in.number(values[c])) return fail("frame " + std::to_string(frame) + " is short (expected " + std::to_string(numChannels) + " channels)");
+				}
+				glm::vec3 translation = skeleton.joints[j].translation;
+				glm::vec3 rotation(0, 0, 0);
+				glm::quat q(1, 0, 0, 0);
+				for (size_t c = 0; c < layout.channels.size(); c++) {
+					switch (layout.channels[c]) {
+					case Xposition: translation.x = values[c]; break;
+					case Yposition: translation.y = values[c]; break;
+					case Zposition: translation.z = values[c]; break;
+					case Xrotation: rotation.x = values[c]; q = q * glm::angleAxis(glm::radians(values[c]), glm::vec3(1, 0, 0)); break;
+					case Yrotation: rotation.y = values[c]; q = q * glm::angleAxis(glm::radians(values[c]), glm::vec3(0, 1, 0)); break;
+					case Zrotation: rotation.z = values[c]; q = q * glm::angleAxis(glm::radians(values[c]), glm::vec3(0, 0, 1)); break;
+					}
+				}
+				if (!layout.yxz) { // R is the rotations multiplied in the order listed; re-read it as Ry Rx Rz
+					float y, x, z;
+					glm::extractEulerAngleYXZ(glm::toMat4(q), y, x, z);
+					rotation = glm::degrees(glm::vec3(x, y, z));
+				}
+				motion.rotations.push_back(rotation);
+				motion.translations.push_back(translation);
+			}
+		}
+
+		// the rest pose is the first frame
+		if (motion.numFrames > 0) {
+			for (int j = 0; j < n; j++) {
+				skeleton.joints[j].rotation = motion.rotation(0, j);
+				skeleton.joints[j].translation = motion.translation(0, j);
+			}
+		}
+		return true;
+	}
+
+	TokenStream &in;
+	SkeletonDesc &skeleton;
+	SkeletonMotion &motion;
+	std::string &error;
+	std::vector<ChannelLayout> layouts; // one per joint
+	int numChannels = 0;
+};
+
+}
+
+bool loadBVH(const std::string &path, SkeletonDesc &skeleton, SkeletonMotion &motion, std::string &error) {
+	TokenStream in;
+	if (!in.open(path)) {
+		error = "can't open " + path;
+		return false;
+	}
+	BVHParser parser(in, skeleton, motion, error);
+	if (!parser.parse()) {
+		error = path + ", " + error;
+		return false;
+	}
+	return true;
+}
+
+namespace {
+
+const int framesWidth = 10; // room left for the BVH frame count, filled in by close()
+const size_t flushSize = 1 << 20;
+
+void appendTriple(std::string &out, const glm::vec3 &v, char separator) {
+	appendNumber(out, v.x);
+	out += separator;
+	appendNumber(out, v.y);
+	out += separator;
+	appendNumber(out, v.z);
+}
+
+void writeBVHJoint(std::string &out, const SkeletonDesc &skeleton, const std::vector<std::vector<int>> &children,
+	int joint, int depth, std::vector<int> &order) {
+	std::string indent(depth, '\t');
+	order.push_back(joint);
+	out += indent + (skeleton.joints[joint].parent < 0 ? "ROOT " : "JOINT ") + skeleton.joints[joint].name + "\n";
+	out += indent + "{\n";
+	out += indent + "\tOFFSET ";
+	appendTriple(out, skeleton.joints[joint].translation, ' ');
+	out += "\n" + indent + "\tCHANNELS 6 Xposition Yposition Zposition Yrotation Xrotation Zrotation\n";
+	for (int child : children[joint]) writeBVHJoint(out, skeleton, children, child, depth + 1, order);
+	if (children[joint].empty()) {
+		out += indent + "\tEnd Site\n" + indent + "\t{\n" + indent + "\t\tOFFSET 0 0 0\n" + indent + "\t}\n";
+	}
+	out += indent + "}\n";
+}
+
+}
+
+bool MotionWriter::open(const std::string &path_, const SkeletonDesc &skeleton, float frameTime_, std::string &error) {
+	close(error);
+	path = path_;
+	file = fopen(path.c_str(), "wb");
+	if (file == NULL) {
+		error = "can't write " + path;
+		return false;
+	}
+	bvh = isBVHPath(path);
+	failed = false;
+	frameTime = frameTime_;
+	frames = 0;
+	buffer.clear();
+	buffer.reserve(flushSize + (flushSize >> 2));
+	order.clear();
+
+	if (bvh) {
+		std::vector<std::vector<int>> children(skeleton.joints.size());
+		for (int i = 0; i < skeleton.joints.size(); i++) {
+			if (skeleton.joints[i].parent >= 0) children[skeleton.joints[i].parent].push_back(i);
+		}
+		buffer += "HIERARCHY\n";
+		for (int i = 0; i < skeleton.joints.size(); i++) {
+			if (skeleton.joints[i].parent < 0) writeBVHJoint(buffer, skeleton, children, i, 0, order);
+		}
+		buffer += "MOTION\nFrames: ";
+		framesOffset = (long)buffer.size();
+		buffer += std::string(framesWidth, ' ') + "\nFrame Time: ";
+		appendNumber(buffer, frameTime);
+		buffer += "\n";
+	}
+	else {
+		buffer += "frame,time";
+		for (int i = 0; i < skeleton.joints.size(); i++) {
+			order.push_back(i);
+			for (const char *channel : { "tx", "ty", "tz", "rx", "ry", "rz" }) buffer += "," + skeleton.joints[i].name + "." + channel;
+		}
+		buffer += "\n";
+	}
+	flush();
+	return !failed;
+}
+
+void MotionWriter::writeFrame(const glm::vec3 *rotations, const glm::vec3 *translations) {
+	if (file == NULL) return;
+	char separator = bvh ? ' ' : ',';
+	if (!bvh) {
+		buffer += std::to_string(frames);
+		buffer += separator;
+		appendNumber(buffer, frames * frameTime);
+	}
+	for (size_t i = 0; i < order.size(); i++) {
+		if (i > 0 || !bvh) buffer += separator;
+		const glm::vec3 &r = rotations[order[i]];
+		appendTriple(buffer, translations[order[i]], separator);
+		buffer += separator;
+		appendTriple(buffer, bvh ? glm::vec3(r.y, r.x, r.z) : r, separator); // BVH channels are Y X Z
+	}
+	buffer += '\n';
+	frames++;
+	if (buffer.size() >= flushSize) flush();
+}
+
+void MotionWriter::flush() {
+	if (!buffer.empty() && fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size()) failed = true;
+	buffer.clear();
+}
+
+bool MotionWriter::close(std::string &error) {
+	if (file == NULL) return true;
+	flush();
+	if (bvh) {
+		std::string count = std::to_string(frames);
+		if (fseek(file, framesOffset, SEEK_SET) != 0 || fwrite(count.data(), 1, count.size(), file) != count.size()) failed = true;
+	}
+	if (fclose(file) != 0) failed = true;
+	file = NULL;
+	if (failed) error = "can't write " + path;
+	return !failed;
+}
@@ -0,0 +1,64 @@
+#ifndef _BVHIO_H_
+#define _BVHIO_H_
+
+#include <stdio.h>
+#include <string>
+#include "skeletonIO.h"
+
+/*
+ * Biovision motion capture (.bvh) files.
+ *
+ * The HIERARCHY becomes a SkeletonDesc (End Sites are dropped - they only give the
+ * length of the last bone) and the MOTION section a SkeletonMotion.  The file is read
+ * through a fixed-size window, a frame at a time, so a capture of any length costs
+ * only what its decoded frames take up (a few floats per joint per frame).
+ *
+ * BVH joints can list their rotation channels in any order; they're converted to the
+ * scene's Euler YXZ order on the way in.
+ */
+
+inline bool isBVHPath(const std::string &path) { return hasExtension(path, ".bvh"); }
+
+bool loadBVH(const std::string &path, SkeletonDesc &skeleton, SkeletonMotion &motion, std::string &error);
+
+//  Streams poses to a .bvh file (or CSV for any other name) a frame at a time.  Frames
+//  collect in a buffer that's written out whenever it passes a megabyte, so memory use
+//  doesn't grow with the length of the take.
+//
+//  BVH joints all get position and rotation channels (rotations in YXZ order), so
+//  nothing the scene can do to a joint is lost.  CSV has a row per frame: frame, time,
+//  then tx ty tz rx ry rz for each joint.
+//
+class MotionWriter {
+public:
+	~MotionWriter() {
+		std::string ignored;
+		close(ignored);
+	}
+
+	// skeleton gives the hierarchy, names and rest offsets
+	bool open(const std::string &path, const SkeletonDesc &skeleton, float frameTime, std::string &error);
+
+	// One pose: a rotation (Euler YXZ degrees) and translation per joint, in skeleton order
+	void writeFrame(const glm::vec3 *rotations, const glm::vec3 *translations);
+
+	// Flushes, fills in the frame count (BVH) and closes
+	bool close(std::string &error);
+
+	int numFrames() const { return frames; }
+
+private:
+	void flush();
+
+	FILE *file = NULL;
+	bool bvh = false;
+	bool failed = false;
+	std::string path;
+	std::string buffer;
+	std::vector<int> order;    // joints in the order their channels are written
+	float frameTime = 0;
+	int frames = 0;
+	long framesOffset = 0;     // where the BVH frame count goes
+};
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef _FILEWATCHER_H_
+#define _FILEWATCHER_H_
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#ifdef __linux__
+#include <errno.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Tells you when files you care about have been written, without blocking.
+ *
+ * On Linux this uses inotify on each file's directory - editors often save by writing
+ * a temp file and renaming it over the original, which a watch on the file itself would
+ * lose track of.  Everywhere else (or if inotify isn't available) it compares
+ * modification times, at most every pollInterval seconds.
+ */
+
+class FileWatcher {
+public:
+	FileWatcher() { }
+	FileWatcher(const FileWatcher &) = delete;
+	FileWatcher &operator=(const FileWatcher &) = delete;
+	~FileWatcher() { clear(); }
+
+	void watch(const std::string &path) {
+		for (const Watched &file : files) if (file.path == path) return;
+		Watched file;
+		file.path = path;
+		std::filesystem::path absolute = std::filesystem::absolute(path);
+		file.dir = absolute.parent_path().string();
+		file.name = absolute.filename().string();
+		file.modified = modifiedTime(path);
+		files.push_back(file);
+#ifdef __linux__
+		if (fd < 0) fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (fd >= 0 && std::find_if(dirs.begin(), dirs.end(), [&](const std::pair<const int, std::string> &d) { return d.second == file.dir; }) == dirs.end()) {
+			int wd = inotify_add_watch(fd, file.dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+			if (wd >= 0) dirs[wd] = file.dir;
+		}
+#endif
+	}
+
+	void clear() {
+		files.clear();
+#ifdef __linux__
+		if (fd >= 0) close(fd); // drops every watch with it
+		fd = -1;
+		dirs.clear();
+#endif
+	}
+
+	bool isWatching() const { return !files.empty(); }
+
+	// Appends every watched path written since the last call, once each
+	//
+	void poll(std::vector<std::string> &changed) {
+		if (files.empty()) return;
+#ifdef __linux__
+		if (fd >= 0 && !dirs.empty()) {
+			alignas(inotify_event) char buffer[4096];
+			for (;;) {
+				ssize_t length = read(fd, buffer, sizeof(buffer));
+				if (length <= 0) break; // EAGAIN: nothing more for now
+				for (char *p = buffer; p < buffer + length; p += sizeof(inotify_event) + ((inotify_event *)p)->len) {
+					const inotify_event *event = (const inotify_event *)p;
+					auto dir = dirs.find(event->wd);
+					if (dir == dirs.end() || event->len == 0) continue;
+					for (const Watched &file : files) {
+						if (file.dir == dir->second && file.name == event->name) addOnce(changed, file.path);
+					}
+				}
+			}
+			return;
+		}
+#endif
+		auto now = std::chrono::steady_clock::now();
+		if (now - lastPoll < std::chrono::duration<float>(pollInterval)) return;
+		lastPoll = now;
+		for (Watched &file : files) {
+			std::filesystem::file_time_type modified = modifiedTime(file.path);
+			if (modified != file.modified) {
+				file.modified = modified;
+				addOnce(changed, file.path);
+			}
+		}
+	}
+
+	float pollInterval = 0.5f; // seconds between checks when polling
+
+private:
+	struct Watched {
+		std::string path;      // as given to watch()
+		std::string dir, name; // absolute directory, file name
+		std::filesystem::file_time_type modified;
+	};
+
+	static std::filesystem::file_time_type modifiedTime(const std::string &path) {
+		std::error_code ec;
+		std::filesystem::file_time_type time = std::filesystem::last_write_time(path, ec);
+		return ec ? std::filesystem::file_time_type() : time;
+	}
+
+	static void addOnce(std::vector<std::string> &changed, const std::string &path) {
+		if (std::find(changed.begin(), changed.end(), path) == changed.end()) changed.push_back(path);
+	}
+
+	std::vector<Watched> files;
+	std::chrono::steady_clock::time_point lastPoll;
+#ifdef __linux__
+	int fd = -1;
+	std::map<int, std::string> dirs; // inotify watch descriptor -> directory
+#endif
+};
+
+#endif
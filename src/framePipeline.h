@@ -0,0 +1,86 @@
+#ifndef _FRAMEPIPELINE_H_
+#define _FRAMEPIPELINE_H_
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+#include "threadPool.h"
+
+/*
+ * A frame's update as an ordered list of stages.  Each stage declares the resources it
+ * reads and writes, as bits the app defines.  run() keeps a stage after every earlier
+ * stage it conflicts with (one writes something the other reads or writes), and runs
+ * stages that don't conflict side by side on the thread pool.  Within a stage, work is
+ * spread over the pool with parallelFor as usual.
+ *
+ * A stage that has a wave to itself (usual when each stage feeds the next) runs on the
+ * calling thread, so a stage that has to be on the main thread can be made to conflict
+ * with everything.
+ */
+
+class FramePipeline {
+public:
+	struct Stage {
+		std::string name;
+		unsigned reads = 0, writes = 0;
+		std::function<void()> run;
+		float ms = 0; // How long it took the last time it ran
+	};
+
+	// Returns the stage's index, for run()
+	int addStage(const std::string &name, unsigned reads, unsigned writes, std::function<void()> run) {
+		Stage stage;
+		stage.name = name;
+		stage.reads = reads;
+		stage.writes = writes;
+		stage.run = std::move(run);
+		stages.push_back(std::move(stage));
+		return (int)stages.size() - 1;
+	}
+
+	// Stages first to last (inclusive); everything by default
+	//
+	void run(int first = 0, int last = -1) {
+		if (last < 0 || last >= (int)stages.size()) last = (int)stages.size() - 1;
+
+		// Each stage goes in the wave after the latest earlier stage it conflicts with, so
+		// nothing in a wave conflicts with anything else in it
+		wave.assign(stages.size(), 0);
+		int numWaves = 0;
+		for (int i = first; i <= last; i++) {
+			for (int j = first; j < i; j++) {
+				if (conflicts(stages[j], stages[i])) wave[i] = std::max(wave[i], wave[j] + 1);
+			}
+			numWaves = std::max(numWaves, wave[i] + 1);
+		}
+
+		for (int w = 0; w < numWaves; w++) {
+			batch.clear();
+			for (int i = first; i <= last; i++) if (wave[i] == w) batch.push_back(i);
+			ThreadPool::shared().parallelFor((int)batch.size(), 1, [this](int begin, int end) {
+				for (int b = begin; b < end; b++) runStage(stages[batch[b]]);
+			});
+		}
+	}
+
+	const std::vector<Stage> &getStages() const { return stages; }
+
+	static bool conflicts(const Stage &a, const Stage &b) {
+		return (a.writes & (b.reads | b.writes)) != 0 || (b.writes & a.reads) != 0;
+	}
+
+private:
+	static void runStage(Stage &stage) {
+		auto start = std::chrono::steady_clock::now();
+		stage.run();
+		stage.ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	std::vector<Stage> stages;
+	std::vector<int> wave;  // Reused by run()
+	std::vector<int> batch;
+};
+
+#endif
@@ -0,0 +1,441 @@
+#ifndef _IKCHAIN_H_
+#define _IKCHAIN_H_
+
+#include <float.h>
+#include <math.h>
+#include <array>
+#include <vector>
+#include <memory>
+#include "transform.h"
+#include "jointAxis.h"
+#include "threadPool.h"
+#include "signedDistanceField.h"
+
+/*
+ * Gradient descent solver for a single IK chain, templated on the joint count.
+ *
+ * Rigs mostly use short chains of known length (2, 3, 4, 7 joints), so IKChain<N>
+ * keeps its state in std::arrays and walks the chain with compile-time unrolled
+ * loops.  IKChain<DynamicChainLength> is the runtime-sized fallback for everything
+ * else.  IKArm talks to either through the IKChainSolver interface: it copies the
+ * joint data in (setLink), runs step() and copies the angles back out.
+ *
+ * All buffers the solve loop touches are sized when the chain is made, so stepping
+ * never allocates - not even for the runtime-sized chain.
+ *
+ * Joint limits are part of the solve: every update is projected back into
+ * [minAngle, maxAngle], and a joint pinned against a limit drops out of the search
+ * direction while the gradient keeps pushing it outwards.
+ *
+ * With an obstacle field, the line searched (Momentum/Adam) steps minimize
+ *   |end - target| + obstacleWeight * sum over bone samples of max(0, margin - sdf)^2
+ * so bones are pushed out of anything they pass through on the way to the target.
+ */
+
+const int DynamicChainLength = 0;
+
+// Everything the solver needs to know about one joint besides its angle
+//
+struct ChainLink {
+	glm::vec3 position = glm::vec3(0, 0, 0);
+	glm::vec3 scale = glm::vec3(1, 1, 1);
+	glm::vec3 pivot = glm::vec3(0, 0, 0);
+	JointAxis axis = JointAxis::Z;
+	float minAngle = -FLT_MAX;  // degrees
+	float maxAngle = FLT_MAX;
+
+	float clampAngle(float angle) const { return fminf(fmaxf(angle, minAngle), maxAngle); }
+
+	bool operator==(const ChainLink &o) const {
+		return position == o.position && scale == o.scale && pivot == o.pivot && axis == o.axis &&
+			minAngle == o.minAngle && maxAngle == o.maxAngle;
+	}
+	bool operator!=(const ChainLink &o) const { return !(*this == o); }
+};
+
+// How step() turns gradients into angle updates
+//
+enum class IKOptimizer {
+	Fixed = 0,     // coordinate descent scaled by learningRate (the original solver)
+	Momentum = 1,  // full gradient with heavy-ball momentum, line searched
+	Adam = 2       // full gradient with per-joint adaptive scaling, line searched
+};
+
+struct IKStepParams {
+	float learningRate;   // Rate of change of the gradient after calculation (Fixed only)
+	float deltaRotation;  // Size of each rotation jump during gradient descent (Fixed only)
+	float distThreshold;  // Maximum acceptable distance - if within, don't move closer
+	IKOptimizer optimizer = IKOptimizer::Fixed;
+
+	// Long chains spread the gradient (Momentum/Adam) over a thread pool; shorter
+	// ones stay on the calling thread
+	ThreadPool *pool = NULL;
+	int parallelMinJoints = 512;
+	int parallelChunk = 128;
+
+	// Obstacles to keep the bones out of (Momentum/Adam; Fixed steps use Momentum when set)
+	const SignedDistanceField *obstacles = NULL;
+	float obstacleMargin = 0.5f;   // clearance wanted around each bone
+	float obstacleWeight = 10;
+	int samplesPerBone = 4;
+};
+
+class IKChainSolver {
+public:
+	virtual ~IKChainSolver() { }
+
+	virtual int size() const = 0;
+	virtual void setLink(int i, const ChainLink &link, float angle) = 0;
+	virtual const ChainLink &getLink(int i) const = 0;
+	virtual float getAngle(int i) const = 0;
+	virtual void setAngle(int i, float angle) = 0;
+
+	// Where the end joint lands with the current angles
+	virtual glm::vec3 endPosition(const Transform &base) const = 0;
+
+	// One gradient descent step.
+	// Returns false if the chain was already within distThreshold (angles untouched).
+	virtual bool step(const Transform &base, const glm::vec3 &target, const IKStepParams &params) = 0;
+
+	// Forget momentum/Adam history, e.g. when the target jumps somewhere new
+	virtual void resetOptimizer() = 0;
+
+	// Independent copy (links, angles and workspace) to solve from another start pose
+	virtual std::unique_ptr<IKChainSolver> clone() const = 0;
+};
+
+template<typename T, int N>
+struct ChainArray {
+	typedef std::array<T, N> type;
+};
+template<typename T>
+struct ChainArray<T, DynamicChainLength> {
+	typedef std::vector<T> type;
+};
+
+template<int N>
+struct Unroll {
+	template<typename F>
+	static void apply(F &&f) {
+		Unroll<N - 1>::apply(f);
+		f(N - 1);
+	}
+};
+template<>
+struct Unroll<0> {
+	template<typename F>
+	static void apply(F &&) { }
+};
+
+template<int N>
+class IKChain : public IKChainSolver {
+public:
+	IKChain(int numJoints = N) {
+		resize(links, numJoints);
+		resize(angles, numJoints);
+		resize(prefix, numJoints);
+		resize(tail, numJoints);
+		resize(gradients, numJoints);
+		resize(firstMoment, numJoints);
+		resize(secondMoment, numJoints);
+		resize(direction, numJoints);
+		resize(savedAngles, numJoints);
+		resize(boneForce, numJoints);
+		resize(boneTorque, numJoints);
+		resetOptimizer();
+	}
+
+	int size() const { return N == DynamicChainLength ? (int)links.size() : N; }
+	void setLink(int i, const ChainLink &link, float angle) {
+		links[i] = link;
+		angles[i] = angle;
+	}
+	const ChainLink &getLink(int i) const { return links[i]; }
+	float getAngle(int i) const { return angles[i]; }
+	void setAngle(int i, float angle) { angles[i] = angle; }
+
+	glm::vec3 endPosition(const Transform &base) const {
+		Transform sim = base;
+		forEachLink([&](int i) {
+			const ChainLink &link = links[i];
+			composeAxisRotation(link.axis, sim, link.position, angles[i], link.scale, link.pivot);
+		});
+		return sim.translation;
+	}
+
+	float distanceToTarget(const Transform &base, const glm::vec3 &target) const {
+		return glm::distance(endPosition(base), target);
+	}
+
+	float getGradient(int i) const { return gradients[i]; }
+
+	void resetOptimizer() {
+		for (int i = 0; i < size(); i++) {
+			firstMoment[i] = 0;
+			secondMoment[i] = 0;
+		}
+		iteration = 0;
+	}
+
+	std::unique_ptr<IKChainSolver> clone() const {
+		return std::unique_ptr<IKChainSolver>(new IKChain<N>(*this));
+	}
+
+	bool step(const Transform &base, const glm::vec3 &target, const IKStepParams &params) {
+		forEachLink([&](int i) { angles[i] = links[i].clampAngle(angles[i]); }); // limits may have just changed
+		if (params.optimizer == IKOptimizer::Fixed && params.obstacles == NULL) return coordinateStep(base, target, params);
+		else return adaptiveStep(base, target, params);
+	}
+
+	// Coordinate descent, last joint to first.  Joints before i don't move while joint i
+	// is being updated, so their concatenated transform (prefix[i]) is computed once per
+	// step, and the end joint's position in joint i's frame (tail[i]) is built up as we
+	// go.  Each finite difference then costs one joint transform instead of a full chain.
+	//
+	bool coordinateStep(const Transform &base, const glm::vec3 &target, const IKStepParams &params) {
+		int n = size();
+		buildPrefix(base);
+		tail[n - 1] = glm::vec3(0, 0, 0);
+
+		float dist = glm::distance(prefix[n - 1].transformPoint(localPoint(n - 1, angles[n - 1])), target);
+		if (dist < params.distThreshold) return false; // Stop moving if we're close enough
+
+		// Update the angles of each joint according to their individual gradients
+		for (int i = n - 1; i >= 0; i--) {
+			// ( F(x + deltaRotation) - F(x) ) / deltaRotation, where F is our error function
+			float fXPlusDelta = glm::distance(prefix[i].transformPoint(localPoint(i, angles[i] + params.deltaRotation)), target);
+			gradients[i] = (fXPlusDelta - dist) / params.deltaRotation;
+			angles[i] = links[i].clampAngle(angles[i] - params.learningRate * gradients[i]);
+
+			glm::vec3 p = localPoint(i, angles[i]);
+			dist = glm::distance(prefix[i].transformPoint(p), target);
+			if (i > 0) tail[i - 1] = p;
+			if (dist < params.distThreshold) break; // Stop moving if we're close enough
+		}
+		return true;
+	}
+
+	// Exact gradient, then a move along the momentum/Adam direction.  The first trial step
+	// is the one that would take a linearized error to zero, so there's no learning rate
+	// to tune; it is halved until the error actually drops, so no step ever makes things
+	// worse.  If nothing helps, the history is dropped and the next step starts fresh.
+	//
+	bool adaptiveStep(const Transform &base, const glm::vec3 &target, const IKStepParams &params) {
+		const float beta1 = 0.9f, beta2 = 0.999f, epsilon = 1e-8f;
+		const float maxStep = 30.0f; // degrees per joint per step
+		const int maxBacktracks = 12;
+
+		int n = size();
+		float fX = fullGradient(base, target, params);
+		if (lastDistance < params.distThreshold && lastPenalty <= 0) return false; // Stop moving if we're close enough
+
+		iteration++;
+		float slope = 0;
+		for (int i = 0; i < n; i++) {
+			float g = gradients[i];
+			if (params.optimizer != IKOptimizer::Adam) {
+				firstMoment[i] = beta1 * firstMoment[i] + g;
+				direction[i] = firstMoment[i];
+			}
+			else {
+				firstMoment[i] = beta1 * firstMoment[i] + (1 - beta1) * g;
+				secondMoment[i] = beta2 * secondMoment[i] + (1 - beta2) * g * g;
+				float mHat = firstMoment[i] / (1 - powf(beta1, (float)iteration));
+				float vHat = secondMoment[i] / (1 - powf(beta2, (float)iteration));
+				direction[i] = mHat / (sqrtf(vHat) + epsilon);
+			}
+			if (pinned(i, direction[i])) {
+				firstMoment[i] = 0;
+				direction[i] = 0;
+			}
+			slope += g * direction[i];
+		}
+		if (slope <= 0) { // history points uphill - fall back to plain gradient
+			resetOptimizer();
+			slope = 0;
+			for (int i = 0; i < n; i++) {
+				direction[i] = pinned(i, gradients[i]) ? 0 : gradients[i];
+				slope += gradients[i] * direction[i];
+			}
+			if (slope <= 0) return true; // flat - nothing to follow
+		}
+
+		for (int i = 0; i < n; i++) savedAngles[i] = angles[i];
+		float t = fX / slope;
+		for (int k = 0; k < maxBacktracks; k++, t *= 0.5f) {
+			for (int i = 0; i < n; i++) {
+				angles[i] = links[i].clampAngle(savedAngles[i] - glm::clamp(t * direction[i], -maxStep, maxStep));
+			}
+			if (objective(base, target, params) < fX) return true;
+		}
+		for (int i = 0; i < n; i++) angles[i] = savedAngles[i];
+		resetOptimizer();
+		return lastDistance >= params.distThreshold; // close enough if no clearer pose is to be had
+	}
+
+	// F(x) and its exact gradient for every joint, in O(n).  Turning joint i moves the end
+	// joint p around the joint's world axis through its pivot, so
+	//   dF/dangle_i = (p - target) / |p - target| . (axis_i x (p - pivot_i)) * pi/180
+	//
+	// Every column only reads the shared prefix pass, so they can be split across threads.
+	//
+	float fullGradient(const Transform &base, const glm::vec3 &target, const IKStepParams &params) {
+		int n = size();
+		buildPrefix(base);
+		tail[n - 1] = glm::vec3(0, 0, 0);
+		glm::vec3 end = prefix[n - 1].transformPoint(localPoint(n - 1, angles[n - 1]));
+		glm::vec3 toTarget = end - target;
+		float fX = glm::length(toTarget);
+		glm::vec3 dir = (fX > 0) ? toTarget / fX : glm::vec3(0, 0, 0);
+
+		auto columns = [&](int begin, int stop) {
+			for (int i = begin; i < stop; i++) {
+				const ChainLink &link = links[i];
+				glm::vec3 axis(0, 0, 0);
+				axis[(int)link.axis] = 1;
+				glm::vec3 worldAxis = prefix[i].rotation * axis;
+				glm::vec3 worldPivot = prefix[i].transformPoint(link.position + link.pivot);
+				gradients[i] = glm::dot(dir, glm::cross(worldAxis, end - worldPivot)) * glm::radians(1.0f);
+			}
+		};
+		if (params.pool != NULL && n >= params.parallelMinJoints) params.pool->parallelFor(n, params.parallelChunk, columns);
+		else columns(0, n);
+
+		lastDistance = fX;
+		lastPenalty = 0;
+		if (params.obstacles != NULL) fX += obstacleGradient(end, params);
+		return fX;
+	}
+
+	// What the line search minimizes: distance to the target plus the obstacle penalty
+	//
+	float objective(const Transform &base, const glm::vec3 &target, const IKStepParams &params) {
+		if (params.obstacles == NULL) return glm::distance(endPosition(base), target);
+		buildPrefix(base);
+		tail[size() - 1] = glm::vec3(0, 0, 0);
+		glm::vec3 end = prefix[size() - 1].transformPoint(localPoint(size() - 1, angles[size() - 1]));
+		return glm::distance(end, target) + obstaclePenalty(end, params, false);
+	}
+
+private:
+	// World position of joint i (its origin), given buildPrefix() and the end position
+	//
+	glm::vec3 jointPosition(int i, const glm::vec3 &end) const {
+		return (i + 1 < size()) ? prefix[i + 1].translation : end;
+	}
+
+	// Penalty over samples along every bone.  With accumulate set, also fills
+	// boneForce[j] / boneTorque[j] with the sums over bones j.. of the penalty's gradient g
+	// at each sample s and of s x g, so joint i's column is just
+	//   axis_i . (boneTorque[i] - pivot_i x boneForce[i])
+	//
+	float obstaclePenalty(const glm::vec3 &end, const IKStepParams &params, bool accumulate) {
+		int n = size();
+		float penalty = 0;
+		glm::vec3 force(0, 0, 0), torque(0, 0, 0);
+		for (int i = n - 1; i >= 0; i--) {
+			if (i < n - 1) { // bone from joint i to joint i + 1 moves with joints 0..i
+				glm::vec3 from = jointPosition(i, end), to = jointPosition(i + 1, end);
+				for (int k = 1; k <= params.samplesPerBone; k++) {
+					glm::vec3 s = from + (to - from) * ((float)k / params.samplesPerBone);
+					glm::vec3 g;
+					float depth = params.obstacleMargin - params.obstacles->sample(s, accumulate ? &g : NULL);
+					if (depth <= 0) continue;
+					penalty += params.obstacleWeight * depth * depth;
+					if (accumulate) {
+						glm::vec3 dPdS = g * (-2 * params.obstacleWeight * depth);
+						force += dPdS;
+						torque += glm::cross(s, dPdS);
+					}
+				}
+			}
+			if (accumulate) {
+				boneForce[i] = force;
+				boneTorque[i] = torque;
+			}
+		}
+		return penalty;
+	}
+
+	// Adds the penalty's gradient to every joint's column; returns the penalty
+	//
+	float obstacleGradient(const glm::vec3 &end, const IKStepParams &params) {
+		lastPenalty = obstaclePenalty(end, params, true);
+		if (lastPenalty <= 0) return 0;
+		for (int i = 0; i < size(); i++) {
+			const ChainLink &link = links[i];
+			glm::vec3 axis(0, 0, 0);
+			axis[(int)link.axis] = 1;
+			glm::vec3 worldAxis = prefix[i].rotation * axis;
+			glm::vec3 worldPivot = prefix[i].transformPoint(link.position + link.pivot);
+			gradients[i] += glm::dot(worldAxis, boneTorque[i] - glm::cross(worldPivot, boneForce[i])) * glm::radians(1.0f);
+		}
+		return lastPenalty;
+	}
+
+	// Joint i is against a limit and moving along -direction would push it further out
+	//
+	bool pinned(int i, float direction) const {
+		return (angles[i] <= links[i].minAngle && direction > 0) || (angles[i] >= links[i].maxAngle && direction < 0);
+	}
+
+	void buildPrefix(const Transform &base) {
+		prefix[0] = base;
+		for (int i = 0; i < size() - 1; i++) {
+			prefix[i + 1] = prefix[i];
+			const ChainLink &link = links[i];
+			composeAxisRotation(link.axis, prefix[i + 1], link.position, angles[i], link.scale, link.pivot);
+		}
+	}
+
+	// End joint position in the frame joint i hangs off, with joint i at 'angle'
+	//
+	glm::vec3 localPoint(int i, float angle) const {
+		const ChainLink &link = links[i];
+		return axisTransformPoint(link.axis, link.position, angle, link.scale, link.pivot, tail[i]);
+	}
+
+	template<typename F>
+	void forEachLink(F &&f) const {
+		if (N == DynamicChainLength) {
+			for (int i = 0; i < (int)links.size(); i++) f(i);
+		}
+		else Unroll<N>::apply(f);
+	}
+
+	template<typename T, size_t M>
+	static void resize(std::array<T, M> &, int) { }
+	template<typename T>
+	static void resize(std::vector<T> &v, int n) { v.resize(n); }
+
+	typename ChainArray<ChainLink, N>::type links;
+	typename ChainArray<float, N>::type angles;
+
+	// solver workspace, allocated once with the chain
+	typename ChainArray<Transform, N>::type prefix;   // base * L0 * ... * L(i-1)
+	typename ChainArray<glm::vec3, N>::type tail;     // end joint in the frame of joint i
+	typename ChainArray<float, N>::type gradients;
+	typename ChainArray<float, N>::type firstMoment;   // momentum velocity / Adam m
+	typename ChainArray<float, N>::type secondMoment;  // Adam v
+	typename ChainArray<float, N>::type direction;
+	typename ChainArray<float, N>::type savedAngles;   // line search rollback
+	typename ChainArray<glm::vec3, N>::type boneForce;   // obstacle penalty gradient, summed from the end
+	typename ChainArray<glm::vec3, N>::type boneTorque;
+	int iteration = 0;
+	float lastDistance = 0;  // parts of the last fullGradient() objective
+	float lastPenalty = 0;
+};
+
+// Picks a fixed-length chain for the lengths our rigs use, runtime-sized otherwise
+//
+inline std::unique_ptr<IKChainSolver> makeIKChain(int numJoints) {
+	switch (numJoints) {
+	case 2: return std::unique_ptr<IKChainSolver>(new IKChain<2>());
+	case 3: return std::unique_ptr<IKChainSolver>(new IKChain<3>());
+	case 4: return std::unique_ptr<IKChainSolver>(new IKChain<4>());
+	case 7: return std::unique_ptr<IKChainSolver>(new IKChain<7>());
+	default: return std::unique_ptr<IKChainSolver>(new IKChain<DynamicChainLength>(numJoints));
+	}
+}
+
+#endif
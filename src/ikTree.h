@@ -0,0 +1,280 @@
+#ifndef _IKTREE_H_
+#define _IKTREE_H_
+
+#include <float.h>
+#include <math.h>
+#include <vector>
+#include "transform.h"
+#include "jointAxis.h"
+
+/*
+ * IK for a whole branching skeleton at once (spine + two arms + two legs, say).
+ *
+ * Every effector pulls on all the joints between it and the root, so shared joints
+ * like the spine get one answer that balances all of them instead of whichever arm
+ * solved last.  Each step stacks the effectors' Jacobians into one system and takes a
+ * damped least squares step:
+ *
+ *      dTheta = J^T (J J^T + damping^2 I)^-1 e
+ *
+ * where e is every effector's offset to its target scaled by sqrt(weight).  J J^T is
+ * only 3 x effectors square, so solving it is cheap however many joints there are.
+ *
+ * Nodes hold the same position/rotation/scale/pivot as a SceneObject (Euler degrees,
+ * YXZ order) and must be added parents first.  A node may only turn about the axes in
+ * its axisMask - one bit per JointAxis - which is how locked joints stay locked.
+ *
+ * Angle limits clamp the Jacobian: an angle sitting on a limit that the step would
+ * push further out has its column zeroed and the system is solved again, so the other
+ * joints make up for it, and whatever is left over is projected back onto the limits.
+ */
+
+struct IKTreeNode {
+	int parent = -1;                      // index in the tree, -1 for a root
+	Transform base;                       // frame a root hangs off (unused otherwise)
+	glm::vec3 position = glm::vec3(0, 0, 0);
+	glm::vec3 rotation = glm::vec3(0, 0, 0);
+	glm::vec3 scale = glm::vec3(1, 1, 1);
+	glm::vec3 pivot = glm::vec3(0, 0, 0);
+	int axisMask = 7;                     // 1 << JointAxis for every axis the solver may turn
+	glm::vec3 minAngles = glm::vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	glm::vec3 maxAngles = glm::vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+};
+
+struct IKEffector {
+	int node;
+	glm::vec3 target = glm::vec3(0, 0, 0);
+	float weight = 1;                     // relative pull when effectors disagree
+};
+
+struct IKTreeParams {
+	float damping = 0.5f;                 // keeps steps sane near singular / unreachable poses
+	float maxStep = 10;                   // largest change to any angle in one step (degrees)
+	float distThreshold = 0.3f;
+};
+
+class IKTree {
+public:
+	void clear() {
+		nodes.clear();
+		effectors.clear();
+		dofsDirty = true;
+	}
+
+	int addNode(const IKTreeNode &node) {
+		nodes.push_back(node);
+		dofsDirty = true;
+		return (int)nodes.size() - 1;
+	}
+	int addEffector(int node, float weight = 1) {
+		IKEffector effector;
+		effector.node = node;
+		effector.weight = weight;
+		effectors.push_back(effector);
+		dofsDirty = true;
+		return (int)effectors.size() - 1;
+	}
+
+	int numNodes() const { return (int)nodes.size(); }
+	int numEffectors() const { return (int)effectors.size(); }
+	IKTreeNode &getNode(int i) { return nodes[i]; }
+	IKEffector &getEffector(int i) { return effectors[i]; }
+
+	// Call after changing an axisMask so the solver picks up the new set of angles
+	void setAxisMask(int i, int mask) {
+		if (nodes[i].axisMask != mask) dofsDirty = true;
+		nodes[i].axisMask = mask;
+	}
+
+	void forwardKinematics() {
+		world.resize(nodes.size());
+		for (int i = 0; i < numNodes(); i++) {
+			const IKTreeNode &node = nodes[i];
+			Transform local = Transform::fromTRS(node.position, Transform::rotationFromEuler(node.rotation), node.scale, node.pivot);
+			world[i] = parentFrame(i) * local;
+		}
+	}
+	const Transform &worldTransform(int i) const { return world[i]; }
+
+	// Furthest any effector is from its target, as of the last forwardKinematics()
+	//
+	float maxError() const {
+		float worst = 0;
+		for (const IKEffector &effector : effectors) {
+			worst = fmaxf(worst, glm::distance(world[effector.node].translation, effector.target));
+		}
+		return worst;
+	}
+
+	// One damped least squares step for all effectors together.
+	// Returns false if every effector was already within distThreshold (angles untouched).
+	//
+	bool step(const IKTreeParams &params) {
+		if (dofsDirty) buildDofs();
+		forwardKinematics();
+		int m = numEffectors() * 3;
+		int k = (int)dofNode.size();
+		if (m == 0 || k == 0 || maxError() < params.distThreshold) return false;
+
+		// weighted error and Jacobian (per radian); a column is zero for every effector
+		// the joint isn't an ancestor of
+		for (int e = 0; e < numEffectors(); e++) {
+			const IKEffector &effector = effectors[e];
+			float w = sqrtf(fmaxf(effector.weight, 0));
+			glm::vec3 end = world[effector.node].translation;
+			glm::vec3 err = (effector.target - end) * w;
+			for (int r = 0; r < 3; r++) weightedError[e * 3 + r] = err[r];
+
+			for (int i = 0; i < numNodes(); i++) ancestor[i] = 0;
+			for (int i = effector.node; i >= 0; i = nodes[i].parent) ancestor[i] = 1;
+			for (int d = 0; d < k; d++) {
+				glm::vec3 column(0, 0, 0);
+				if (ancestor[dofNode[d]]) column = glm::cross(dofAxis(d), end - dofCenter(d)) * w;
+				for (int r = 0; r < 3; r++) jacobian[(e * 3 + r) * k + d] = column[r];
+			}
+		}
+
+		// Solve, then drop any angle the answer pushes through its limit and solve again.
+		// Each pass only ever pins more angles, so this is bounded by the number of angles.
+		for (int d = 0; d < k; d++) pinned[d] = 0;
+		for (int pass = 0; pass <= k; pass++) {
+			solveDamped(m, k, params.damping);
+			bool pinnedMore = false;
+			for (int d = 0; d < k; d++) {
+				if (pinned[d]) continue;
+				const IKTreeNode &node = nodes[dofNode[d]];
+				float angle = node.rotation[dofAxisIndex[d]];
+				if ((angle <= node.minAngles[dofAxisIndex[d]] && delta[d] < 0) || (angle >= node.maxAngles[dofAxisIndex[d]] && delta[d] > 0)) {
+					pinned[d] = 1;
+					for (int a = 0; a < m; a++) jacobian[a * k + d] = 0;
+					pinnedMore = true;
+				}
+			}
+			if (!pinnedMore) break;
+		}
+
+		float largest = 0;
+		for (int d = 0; d < k; d++) largest = fmaxf(largest, fabsf(delta[d]));
+		float shrink = (largest > params.maxStep) ? params.maxStep / largest : 1;
+		for (int d = 0; d < k; d++) {
+			IKTreeNode &node = nodes[dofNode[d]];
+			int axis = dofAxisIndex[d];
+			node.rotation[axis] = glm::clamp(node.rotation[axis] + delta[d] * shrink, node.minAngles[axis], node.maxAngles[axis]);
+		}
+		return true;
+	}
+
+private:
+	Transform parentFrame(int i) const {
+		return (nodes[i].parent >= 0) ? world[nodes[i].parent] : nodes[i].base;
+	}
+
+	void buildDofs() {
+		dofNode.clear();
+		dofAxisIndex.clear();
+		for (int i = 0; i < numNodes(); i++) {
+			for (int axis = 0; axis < 3; axis++) {
+				if (!(nodes[i].axisMask & (1 << axis))) continue;
+				dofNode.push_back(i);
+				dofAxisIndex.push_back(axis);
+			}
+		}
+		int m = numEffectors() * 3;
+		int k = (int)dofNode.size();
+		jacobian.resize(m * k);
+		system.resize(m * m);
+		error.resize(m);
+		weightedError.resize(m);
+		delta.resize(k);
+		pinned.resize(k);
+		ancestor.resize(nodes.size());
+		dofsDirty = false;
+	}
+
+	// World direction of an Euler axis.  R = Ry * Rx * Rz, so X turns in the frame left
+	// after Y, and Z in the frame left after Y and X.
+	//
+	glm::vec3 dofAxis(int d) const {
+		const IKTreeNode &node = nodes[dofNode[d]];
+		glm::quat frame = parentFrame(dofNode[d]).rotation;
+		switch ((JointAxis)dofAxisIndex[d]) {
+		case JointAxis::Y:
+			return frame * glm::vec3(0, 1, 0);
+		case JointAxis::X:
+			return frame * axisRotation(JointAxis::Y, node.rotation.y) * glm::vec3(1, 0, 0);
+		default:
+			return frame * axisRotation(JointAxis::Y, node.rotation.y) * axisRotation(JointAxis::X, node.rotation.x) * glm::vec3(0, 0, 1);
+		}
+	}
+
+	// The point the node turns about (its pivot), in world space
+	glm::vec3 dofCenter(int d) const {
+		const IKTreeNode &node = nodes[dofNode[d]];
+		return parentFrame(dofNode[d]).transformPoint(node.position + node.pivot);
+	}
+
+	// delta (degrees) = J^T (J J^T + damping^2 I)^-1 e
+	//
+	void solveDamped(int m, int k, float damping) {
+		for (int a = 0; a < m; a++) {
+			error[a] = weightedError[a];
+			for (int b = 0; b <= a; b++) {
+				float sum = 0;
+				for (int d = 0; d < k; d++) sum += jacobian[a * k + d] * jacobian[b * k + d];
+				system[a * m + b] = sum;
+				system[b * m + a] = sum;
+			}
+			system[a * m + a] += damping * damping;
+		}
+		solveCholesky(m);
+		for (int d = 0; d < k; d++) {
+			float sum = 0;
+			for (int a = 0; a < m; a++) sum += jacobian[a * k + d] * error[a];
+			delta[d] = glm::degrees(sum);
+		}
+	}
+
+	// In-place Cholesky factorization of system, then solve for error (overwritten with y)
+	//
+	void solveCholesky(int m) {
+		for (int j = 0; j < m; j++) {
+			float diag = system[j * m + j];
+			for (int p = 0; p < j; p++) diag -= system[j * m + p] * system[j * m + p];
+			diag = sqrtf(fmaxf(diag, 1e-12f));
+			system[j * m + j] = diag;
+			for (int i = j + 1; i < m; i++) {
+				float sum = system[i * m + j];
+				for (int p = 0; p < j; p++) sum -= system[i * m + p] * system[j * m + p];
+				system[i * m + j] = sum / diag;
+			}
+		}
+		for (int i = 0; i < m; i++) {       // L z = e
+			float sum = error[i];
+			for (int p = 0; p < i; p++) sum -= system[i * m + p] * error[p];
+			error[i] = sum / system[i * m + i];
+		}
+		for (int i = m - 1; i >= 0; i--) {  // L^T y = z
+			float sum = error[i];
+			for (int p = i + 1; p < m; p++) sum -= system[p * m + i] * error[p];
+			error[i] = sum / system[i * m + i];
+		}
+	}
+
+	std::vector<IKTreeNode> nodes;
+	std::vector<IKEffector> effectors;
+	std::vector<Transform> world;
+
+	// solver workspace, rebuilt when the nodes, effectors or axis masks change
+	bool dofsDirty = true;
+	std::vector<int> dofNode;         // which node each solved angle belongs to ...
+	std::vector<int> dofAxisIndex;    // ... and which of its Euler angles it is
+	std::vector<float> jacobian;      // (3 * effectors) x dofs, row major
+	std::vector<float> system;
+	std::vector<float> error;
+	std::vector<float> weightedError;
+	std::vector<float> delta;
+	std::vector<unsigned char> pinned;  // angles held at a limit this step
+	std::vector<unsigned char> ancestor;
+};
+
+#endif
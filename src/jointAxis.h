@@ -0,0 +1,102 @@
+#ifndef _JOINTAXIS_H_
+#define _JOINTAXIS_H_
+
+#include <math.h>
+#include "transform.h"
+
+/*
+ * Single-axis joint rotations for IK chains.
+ *
+ * A locked joint only ever rotates about X, Y or Z, so instead of building a full
+ * yaw/pitch/roll rotation the kernels below are specialized per axis at compile
+ * time: one sincos of the half angle, then a handful of multiply-adds to fold the
+ * rotation (and its pivot) into a running Transform.
+ */
+
+enum class JointAxis { X = 0, Y = 1, Z = 2 };
+
+template<int K>
+struct AxisKernel {
+	// the two components that actually move when rotating about axis K
+	static const int I = (K + 1) % 3;
+	static const int J = (K + 2) % 3;
+
+	static float &quatComponent(glm::quat &q) {
+		if (K == 0) return q.x;
+		else if (K == 1) return q.y;
+		else return q.z;
+	}
+	static float &quatI(glm::quat &q) { return AxisKernel<I>::quatComponent(q); }
+	static float &quatJ(glm::quat &q) { return AxisKernel<J>::quatComponent(q); }
+
+	static glm::quat rotation(float degrees) {
+		float half = glm::radians(degrees) * 0.5f;
+		glm::quat q(cosf(half), 0, 0, 0);
+		quatComponent(q) = sinf(half);
+		return q;
+	}
+
+	// v rotated about the axis, given sin/cos of the full angle
+	//
+	static glm::vec3 rotate(const glm::vec3 &v, float sinA, float cosA) {
+		glm::vec3 r = v;
+		r[I] = cosA * v[I] - sinA * v[J];
+		r[J] = sinA * v[I] + cosA * v[J];
+		return r;
+	}
+
+	// p carried through the local transform of a joint rotated by 'degrees' about this axis
+	//
+	static glm::vec3 transformPoint(const glm::vec3 &trans, float degrees, const glm::vec3 &scale, const glm::vec3 &pivot, const glm::vec3 &p) {
+		float angle = glm::radians(degrees);
+		return trans + pivot + rotate(scale * p - pivot, sinf(angle), cosf(angle));
+	}
+
+	// sim = sim * (local transform of a joint rotated by 'degrees' about this axis)
+	//
+	static void compose(Transform &sim, const glm::vec3 &trans, float degrees, const glm::vec3 &scale, const glm::vec3 &pivot) {
+		float half = glm::radians(degrees) * 0.5f;
+		float s = sinf(half);
+		float c = cosf(half);
+
+		// local translation with the pivot folded in (see Transform::fromTRS)
+		glm::vec3 localTrans = trans + pivot - rotate(pivot, 2 * s * c, c * c - s * s);
+		sim.translation += sim.rotation * (sim.scale * localTrans);
+
+		// sim.rotation * (c + s * axis)
+		glm::quat q = sim.rotation;
+		float w = q.w, k = quatComponent(q), i = quatI(q), j = quatJ(q);
+		sim.rotation.w = c * w - s * k;
+		quatComponent(sim.rotation) = c * k + s * w;
+		quatI(sim.rotation) = c * i + s * j;
+		quatJ(sim.rotation) = c * j - s * i;
+
+		sim.scale *= scale;
+	}
+};
+
+inline void composeAxisRotation(JointAxis axis, Transform &sim, const glm::vec3 &trans, float degrees, const glm::vec3 &scale, const glm::vec3 &pivot) {
+	switch (axis) {
+	case JointAxis::X: AxisKernel<0>::compose(sim, trans, degrees, scale, pivot); break;
+	case JointAxis::Y: AxisKernel<1>::compose(sim, trans, degrees, scale, pivot); break;
+	case JointAxis::Z: AxisKernel<2>::compose(sim, trans, degrees, scale, pivot); break;
+	}
+}
+
+inline glm::vec3 axisTransformPoint(JointAxis axis, const glm::vec3 &trans, float degrees, const glm::vec3 &scale, const glm::vec3 &pivot, const glm::vec3 &p) {
+	switch (axis) {
+	case JointAxis::X: return AxisKernel<0>::transformPoint(trans, degrees, scale, pivot, p);
+	case JointAxis::Y: return AxisKernel<1>::transformPoint(trans, degrees, scale, pivot, p);
+	default: return AxisKernel<2>::transformPoint(trans, degrees, scale, pivot, p);
+	}
+}
+
+inline glm::quat axisRotation(JointAxis axis, float degrees) {
+	switch (axis) {
+	case JointAxis::X: return AxisKernel<0>::rotation(degrees);
+	case JointAxis::Y: return AxisKernel<1>::rotation(degrees);
+	default: return AxisKernel<2>::rotation(degrees);
+	}
+}
+
+#endif
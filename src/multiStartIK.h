@@ -0,0 +1,106 @@
+#ifndef _MULTISTARTIK_H_
+#define _MULTISTARTIK_H_
+
+#include <math.h>
+#include <atomic>
+#include <memory>
+#include <random>
+#include <vector>
+#include "ikChain.h"
+#include "reachability.h"
+#include "threadPool.h"
+
+/*
+ * Restarts a stalled solve from several start poses at once and keeps whichever gets
+ * closest.  Gradient descent on a locked-axis chain has local minima - the classic one
+ * is the yaw joint facing away from the target, where every hinge only makes it worse -
+ * and from inside one it never gets out on its own.  The seeds are:
+ *
+ *   0  the current pose (in case it was about to get there anyway)
+ *   1  the base joint turned half a turn
+ *   2  the base joint turned half a turn with every other joint mirrored
+ *   3  stretched straight at the target (yaw + hinge chains only)
+ *   4+ random poses
+ *
+ * Each seed is solved on its own copy of the chain, one seed per pool job; as soon as
+ * one of them gets within the threshold the rest give up.
+ */
+
+class MultiStartIK {
+public:
+	// Drop the seed chains, e.g. when the arm's joints change
+	void clear() { seeds.clear(); }
+
+	// Leaves the best pose found in chain (if it beats the current one) and returns
+	// its distance to the target
+	//
+	float solve(IKChainSolver &chain, const Transform &base, const glm::vec3 &target, const IKStepParams &params,
+		int numSeeds, int maxIterations, ThreadPool *pool) {
+		int n = chain.size();
+		if ((int)seeds.size() != numSeeds || (numSeeds > 0 && seeds[0]->size() != n)) {
+			seeds.clear();
+			for (int s = 0; s < numSeeds; s++) seeds.push_back(chain.clone());
+			errors.resize(numSeeds);
+		}
+
+		glm::vec3 localTarget = base.inverse().transformPoint(target);
+		for (int s = 0; s < numSeeds; s++) seedPose(s, *seeds[s], chain, localTarget);
+
+		std::atomic<bool> solved{ false };
+		auto run = [&](int begin, int end) {
+			for (int s = begin; s < end; s++) {
+				IKChainSolver &seed = *seeds[s];
+				int iterations = 0;
+				while (iterations < maxIterations && !solved && seed.step(base, target, params)) iterations++;
+				errors[s] = glm::distance(seed.endPosition(base), target);
+				if (errors[s] < params.distThreshold) solved = true;
+			}
+		};
+		if (pool != NULL) pool->parallelFor(numSeeds, 1, run);
+		else run(0, numSeeds);
+
+		float currentError = glm::distance(chain.endPosition(base), target);
+		lastBestSeed = -1;
+		for (int s = 0; s < numSeeds; s++) {
+			if (errors[s] < currentError) {
+				currentError = errors[s];
+				lastBestSeed = s;
+			}
+		}
+		if (lastBestSeed >= 0) {
+			const IKChainSolver &best = *seeds[lastBestSeed];
+			for (int i = 0; i < n; i++) chain.setAngle(i, best.getAngle(i));
+			chain.resetOptimizer();
+		}
+		return currentError;
+	}
+
+	int lastBestSeed = -1; // Seed the last solve kept, -1 if none beat the current pose
+
+private:
+	void seedPose(int s, IKChainSolver &seed, const IKChainSolver &chain, const glm::vec3 &localTarget) {
+		int n = chain.size();
+		for (int i = 0; i < n; i++) seed.setLink(i, chain.getLink(i), chain.getAngle(i));
+		seed.resetOptimizer();
+
+		if (s == 0) return;
+		if (s == 1 || s == 2) {
+			seed.setAngle(0, chain.getAngle(0) + 180);
+			if (s == 2) {
+				for (int i = 1; i < n; i++) seed.setAngle(i, -chain.getAngle(i));
+			}
+			return;
+		}
+		if (s == 3 && stretchTowards(seed, localTarget)) return;
+
+		// random angles are drawn here, on the calling thread, so the seeds are repeatable
+		std::uniform_real_distribution<float> angle(-180.0f, 180.0f);
+		for (int i = 0; i < n; i++) seed.setAngle(i, angle(rng));
+	}
+
+	std::vector<std::unique_ptr<IKChainSolver>> seeds;
+	std::vector<float> errors;
+	std::mt19937 rng{ 12345 };
+};
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef _OBJECTPOOL_H_
+#define _OBJECTPOOL_H_
+
+#include <stdint.h>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+/*
+ * Storage for one type of object, in blocks of BlockSize slots.  Objects never move once
+ * created, so plain pointers to them stay good until they're released; releasing puts
+ * the slot on a free list for the next create(), and clear() drops everything at once
+ * while keeping the blocks for reuse - so memory stays flat however often a scene is
+ * torn down and rebuilt.
+ *
+ * A Handle is a slot index plus the slot's generation, which goes up every time the
+ * slot is released.  get() on a handle to something that has since been released (even
+ * if the slot now holds something else) returns NULL instead of a dangling pointer.
+ */
+
+template<typename T>
+class ObjectPool {
+public:
+	struct Handle {
+		uint32_t index = UINT32_MAX;
+		uint32_t generation = 0;
+
+		bool isNull() const { return index == UINT32_MAX; }
+		bool operator==(const Handle &o) const { return index == o.index && generation == o.generation; }
+		bool operator!=(const Handle &o) const { return !(*this == o); }
+	};
+
+	ObjectPool() { }
+	ObjectPool(const ObjectPool &) = delete;
+	ObjectPool &operator=(const ObjectPool &) = delete;
+	~ObjectPool() { clear(); }
+
+	template<typename... Args>
+	T *create(Args&&... args) {
+		uint32_t index;
+		if (freeList != UINT32_MAX) {
+			index = freeList;
+			freeList = slot(index).nextFree;
+		}
+		else {
+			if (used == blocks.size() * BlockSize) addBlock();
+			index = used++;
+		}
+		Slot &s = slot(index);
+		T *object = new (s.storage) T(std::forward<Args>(args)...);
+		s.alive = true;
+		live++;
+		return object;
+	}
+
+	// Destroy obj (which must have come from this pool) and free its slot
+	void release(T *obj) {
+		Slot *s = toSlot(obj);
+		obj->~T();
+		s->alive = false;
+		s->generation++;
+		s->nextFree = freeList;
+		freeList = s->index;
+		live--;
+	}
+
+	// Destroy everything; the memory is kept for the next lot
+	void clear() {
+		for (uint32_t i = 0; i < used; i++) {
+			Slot &s = slot(i);
+			if (!s.alive) continue;
+			object(s)->~T();
+			s.alive = false;
+			s.generation++;
+		}
+		used = 0;
+		freeList = UINT32_MAX;
+		live = 0;
+	}
+
+	// Null handle for anything not from this pool
+	Handle handleOf(const T *obj) const {
+		Handle handle;
+		if (!owns(obj)) return handle;
+		const Slot *s = toSlot(obj);
+		handle.index = s->index;
+		handle.generation = s->generation;
+		return handle;
+	}
+
+	// The object, or NULL if it has been released since the handle was taken
+	T *get(Handle handle) const {
+		if (handle.index >= used) return NULL;
+		Slot &s = slot(handle.index);
+		return (s.alive && s.generation == handle.generation) ? object(s) : NULL;
+	}
+
+	bool owns(const T *obj) const {
+		const unsigned char *p = (const unsigned char *)obj;
+		for (auto &block : blocks) {
+			const unsigned char *first = (const unsigned char *)block.get();
+			if (p >= first && p < first + BlockSize * sizeof(Slot)) return true;
+		}
+		return false;
+	}
+
+	int size() const { return (int)live; }
+
+	// fn(T*) for every live object, in memory order
+	template<typename F>
+	void forEach(F fn) {
+		for (uint32_t i = 0; i < used; i++) {
+			Slot &s = slot(i);
+			if (s.alive) fn(object(s));
+		}
+	}
+
+	static const uint32_t BlockSize = 256;
+
+private:
+	struct Slot {
+		alignas(T) unsigned char storage[sizeof(T)]; // first, so a T* is also its Slot*
+		uint32_t index = 0;
+		uint32_t generation = 0;
+		uint32_t nextFree = UINT32_MAX;
+		bool alive = false;
+	};
+
+	void addBlock() {
+		uint32_t first = (uint32_t)blocks.size() * BlockSize;
+		blocks.emplace_back(new Slot[BlockSize]);
+		for (uint32_t i = 0; i < BlockSize; i++) blocks.back()[i].index = first + i;
+	}
+
+	Slot &slot(uint32_t index) const { return blocks[index / BlockSize][index % BlockSize]; }
+	static T *object(Slot &s) { return std::launder(reinterpret_cast<T *>(s.storage)); }
+	static Slot *toSlot(const T *obj) { return reinterpret_cast<Slot *>(const_cast<T *>(obj)); }
+
+	std::vector<std::unique_ptr<Slot[]>> blocks;
+	uint32_t used = 0;                 // slots handed out since the last clear(), live or freed
+	uint32_t freeList = UINT32_MAX;    // released slots, most recent first
+	uint32_t live = 0;
+};
+
+#endif
@@ -73,7 +73,7 @@ void Cone::draw() {
 
 	//rotateToVector(glm::vec3(0, 1, 0), glm::vec3(1, 1, 1));
 
-	glm::mat4 m = getMatrix();
+	glm::mat4 m = world.toMat4();
 
 	//   push the current stack matrix and multiply by this object's
 	//   matrix. now all vertices will be transformed by this matrix
@@ -99,10 +99,9 @@ bool Cone::intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &normal) {
 
 	// transform Ray to object space.  
 	//
-	glm::mat4 mInv = glm::inverse(getMatrix());
-	glm::vec4 p = mInv * glm::vec4(ray.p.x, ray.p.y, ray.p.z, 1.0);
-	glm::vec4 p1 = mInv * glm::vec4(ray.p + ray.d, 1.0);
-	glm::vec3 d = glm::normalize(p1 - p);
+	Transform inv = getTransform().inverse();
+	glm::vec3 p = inv.transformPoint(ray.p);
+	glm::vec3 d = glm::normalize(inv.transformVector(ray.d));
 
 
 	// intesect method we use will be Willam's  (see box.h and box.cc for reference).
@@ -124,9 +123,9 @@ bool Cone::intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &normal) {
 //
 void Cube::draw() {
 
-	//   get the current transformation matrix for this object
+	//   get this frame's transformation matrix for this object
 	//
-	glm::mat4 m = getMatrix();
+	glm::mat4 m = world.toMat4();
 
 	//   push the current stack matrix and multiply by this object's
 	//   matrix. now all vertices dran will be transformed by this matrix
@@ -144,9 +143,9 @@ void Cube::draw() {
 
 void Sphere::draw() {
 
-	//   get the current transformation matrix for this object
+	//   get this frame's transformation matrix for this object
    //
-	glm::mat4 m = getMatrix();
+	glm::mat4 m = world.toMat4();
 
 	//   push the current stack matrix and multiply by this object's
 	//   matrix. now all vertices dran will be transformed by this matrix
@@ -166,12 +165,11 @@ bool Sphere::intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &normal) {
 
 	// transform Ray to object space.  
 	//
-	glm::mat4 mInv = glm::inverse(getMatrix());
-	glm::vec4 p = mInv * glm::vec4(ray.p.x, ray.p.y, ray.p.z, 1.0);
-	glm::vec4 p1 = mInv * glm::vec4(ray.p + ray.d, 1.0);
-	glm::vec3 d = glm::normalize(p1 - p);
+	Transform inv = getTransform().inverse();
+	glm::vec3 p = inv.transformPoint(ray.p);
+	glm::vec3 d = glm::normalize(inv.transformVector(ray.d));
 
-	return (glm::intersectRaySphere(glm::vec3(p), d, glm::vec3(0, 0, 0), radius, point, normal));
+	return (glm::intersectRaySphere(p, d, glm::vec3(0, 0, 0), radius, point, normal));
 }
 
 
@@ -186,10 +184,9 @@ bool Cube::intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &normal) {
 
 	// transform Ray to object space.  
 	//
-	glm::mat4 mInv = glm::inverse(getMatrix());
-	glm::vec4 p = mInv * glm::vec4(ray.p.x, ray.p.y, ray.p.z, 1.0);
-	glm::vec4 p1 = mInv * glm::vec4(ray.p + ray.d, 1.0);
-	glm::vec3 d = glm::normalize(p1 - p);
+	Transform inv = getTransform().inverse();
+	glm::vec3 p = inv.transformPoint(ray.p);
+	glm::vec3 d = glm::normalize(inv.transformVector(ray.d));
 
 
 	// intesect method we use will be Willam's  (see box.h and box.cc for reference).
@@ -229,10 +226,27 @@ bool Plane::intersect(const Ray &ray, glm::vec3 & point, glm::vec3 & normalAtInt
 void ofApp::setup() {
 	// GUI
 	gui.setup();
+	gui.add(IKArm::optimizer);
 	gui.add(IKArm::learningRate);
 	gui.add(IKArm::deltaRotation);
 	gui.add(IKArm::distThreshold);
+	gui.add(IKArm::useReachabilityMap);
+	gui.add(IKArm::useSolutionCache);
+	gui.add(IKArm::defaultSolveRate);
+	gui.add(IKArm::extrapolatePoses);
+	gui.add(IKScheduler::enabled);
+	gui.add(IKScheduler::budgetMs);
+	gui.add(IKArm::avoidObstacles);
+	gui.add(IKArm::obstacleMargin);
+	gui.add(IKArm::useMultiStart);
+	gui.add(IKArm::multiStartSeeds);
+	gui.add(IKArm::parallelMinJoints);
+	gui.add(IKTreeRig::damping);
 	gui.add(Animation::lengthInSeconds);
+	gui.add(hotReload);
+	gui.add(exportSeconds);
+	gui.add(exportRate);
+	gui.add(showFrameStats);
 
 	ofSetBackgroundColor(ofColor::black);
 	mainCam.setDistance(15);
@@ -260,15 +274,191 @@ void ofApp::setup() {
 	//
 	// ground plane
 	//
-	scene.push_back(new Plane(glm::vec3(0, -2, 0), glm::vec3(0, 1, 0)));   
+	addToScene(new Plane(glm::vec3(0, -2, 0), glm::vec3(0, 1, 0)));   
 
+	setupFramePipeline();
+}
+
+//  The frame, stage by stage, in the order of the stage enum in ofApp.h.  Files that
+//  have finished loading land first; then the animation poses the scene, the IK solves
+//  from that pose, and world transforms, bounds and the draw list follow from the result.
+//
+void ofApp::setupFramePipeline() {
+	using namespace FrameResource;
+	framePipeline.addStage("input", All, All, [this] {
+		bool saved;
+		string saveMessage;
+		if (skeletonWriter.poll(saved, saveMessage)) cout << saveMessage << endl;
+		checkForReloads();
+		finishLoading();
+	});
+	framePipeline.addStage("animation", SceneGraph | LocalPose, LocalPose, [this] {
+		if (animation != nullptr) animation->update();
+	});
+	framePipeline.addStage("obstacles", SceneGraph | LocalPose, Obstacles, [this] {
+		if (IKArm::avoidObstacles) updateObstacles();
+	});
+	framePipeline.addStage("ik", SceneGraph | LocalPose | Obstacles | Camera, LocalPose, [this] { updateIK(); });
+	framePipeline.addStage("transforms", SceneGraph | LocalPose, WorldTransforms, [this] { propagateTransforms(); });
+	framePipeline.addStage("bounds", SceneGraph | WorldTransforms, Bounds, [this] {
+		ThreadPool::shared().parallelFor(scene.size(), 256, [this](int begin, int end) {
+			for (int i = begin; i < end; i++) scene[i]->refitBounds();
+		});
+	});
+	framePipeline.addStage("draw list", SceneGraph | Bounds | Camera, DrawList, [this] { buildDrawList(); });
 }
 
  
 //--------------------------------------------------------------
 void ofApp::update() {
-	for (auto obj : scene) obj->update();
-	if(animation != nullptr) animation->update();
+	framePipeline.run();
+}
+
+//  Solvers on separate skeletons share nothing, so each island (see buildIKIslands) is
+//  a job of its own, and solvers within one run in scene order.  The scheduler's budget
+//  covers all the arms together, so with it on they still go through it one at a time.
+//
+void ofApp::updateIK() {
+	IKArm::numActive = 0;
+	IKArm::numParked = 0;
+	IKArm::numBlended = 0;
+	if (IKScheduler::enabled) {
+		ikArms.clear();
+		for (auto obj : scene) {
+			IKArm* arm = dynamic_cast<IKArm*>(obj);
+			if (arm != nullptr) {
+				if (arm->jointsAlive()) ikArms.push_back(arm);
+			}
+			else obj->update();
+		}
+		ikScheduler.run(ikArms, theCam->getPosition(), selected);
+		return;
+	}
+
+	buildIKIslands();
+	ThreadPool::shared().parallelFor((int)ikIslandStart.size() - 1, 1, [this](int begin, int end) {
+		for (int island = begin; island < end; island++) {
+			for (int i = ikIslandStart[island]; i < ikIslandStart[island + 1]; i++) ikSolvers[ikOrder[i].second]->update();
+		}
+	});
+}
+
+//  Solvers that touch the same skeleton - any of their joints, targets or poles hang
+//  off the same root - go in the same island, by union-find over the solvers.  Nothing
+//  one island's solvers read or write belongs to another's.
+//
+void ofApp::buildIKIslands() {
+	ikSolvers.clear();
+	for (auto obj : scene) {
+		if (IKArm* arm = dynamic_cast<IKArm*>(obj)) {
+			if (arm->jointsAlive()) ikSolvers.push_back(arm);
+		}
+		else if (IKTreeRig* rig = dynamic_cast<IKTreeRig*>(obj)) {
+			if (Joint::allAlive(rig->handles)) ikSolvers.push_back(rig);
+		}
+	}
+
+	int n = ikSolvers.size();
+	ikUnion.resize(n);
+	for (int i = 0; i < n; i++) ikUnion[i] = i;
+	auto findIsland = [this](int i) {
+		while (ikUnion[i] != i) i = ikUnion[i] = ikUnion[ikUnion[i]];
+		return i;
+	};
+	ikRootOwner.clear();
+	auto touch = [&](int i, SceneObject* obj) {
+		if (obj == NULL) return;
+		while (obj->parent != NULL) obj = obj->parent;
+		auto owner = ikRootOwner.emplace(obj, i);
+		if (!owner.second) ikUnion[findIsland(i)] = findIsland(owner.first->second);
+	};
+	for (int i = 0; i < n; i++) {
+		if (IKArm* arm = dynamic_cast<IKArm*>(ikSolvers[i])) {
+			for (auto joint : arm->joints) touch(i, joint);
+			touch(i, arm->target);
+			touch(i, arm->getPole());
+		}
+		else if (IKTreeRig* rig = dynamic_cast<IKTreeRig*>(ikSolvers[i])) {
+			for (auto joint : rig->joints) touch(i, joint);
+			for (auto target : rig->targets) touch(i, target);
+		}
+	}
+
+	// Islands in order of their first solver, scene order within each
+	ikIslandFirst.assign(n, -1);
+	ikOrder.resize(n);
+	for (int i = 0; i < n; i++) {
+		int root = findIsland(i);
+		if (ikIslandFirst[root] < 0) ikIslandFirst[root] = i;
+		ikOrder[i] = make_pair(ikIslandFirst[root], i);
+	}
+	sort(ikOrder.begin(), ikOrder.end());
+	ikIslandStart.clear();
+	for (int i = 0; i < n; i++) {
+		if (i == 0 || ikOrder[i].first != ikOrder[i - 1].first) ikIslandStart.push_back(i);
+	}
+	ikIslandStart.push_back(n);
+}
+
+//  Parents before children, a root's whole tree per job
+//
+void ofApp::propagateTransforms() {
+	sceneRoots.clear();
+	for (auto obj : scene) {
+		if (obj->parent == NULL) sceneRoots.push_back(obj);
+	}
+	ThreadPool::shared().parallelFor(sceneRoots.size(), 16, [this](int begin, int end) {
+		vector<SceneObject*> stack;
+		for (int i = begin; i < end; i++) {
+			SceneObject* root = sceneRoots[i];
+			root->world = root->getLocalTransform();
+			stack.push_back(root);
+			while (!stack.empty()) {
+				SceneObject* obj = stack.back();
+				stack.pop_back();
+				for (auto child : obj->childList) {
+					child->world = obj->world * child->getLocalTransform();
+					stack.push_back(child);
+				}
+			}
+		}
+	});
+}
+
+//  Tests each object's bounding sphere against the planes of the camera's view frustum
+//  (pulled straight out of its view-projection matrix), keeping scene order
+//
+void ofApp::buildDrawList() {
+	glm::mat4 m = theCam->getModelViewProjectionMatrix();
+	glm::vec4 planes[6];
+	glm::vec4 w(m[0][3], m[1][3], m[2][3], m[3][3]);
+	for (int i = 0; i < 3; i++) {
+		glm::vec4 row(m[0][i], m[1][i], m[2][i], m[3][i]);
+		planes[2 * i] = w + row;
+		planes[2 * i + 1] = w - row;
+	}
+	for (auto &plane : planes) plane /= glm::length(glm::vec3(plane));
+
+	visible.resize(scene.size());
+	ThreadPool::shared().parallelFor(scene.size(), 256, [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			SceneObject* obj = scene[i];
+			bool inside = true;
+			if (obj->boundsRadius < FLT_MAX) {
+				for (auto &plane : planes) {
+					if (glm::dot(glm::vec3(plane), obj->boundsCenter) + plane.w < -obj->boundsRadius) {
+						inside = false;
+						break;
+					}
+				}
+			}
+			visible[i] = inside;
+		}
+	});
+	drawList.clear();
+	for (int i = 0; i < scene.size(); i++) {
+		if (visible[i]) drawList.push_back(scene[i]);
+	}
 }
 
 //--------------------------------------------------------------
@@ -284,11 +474,11 @@ void ofApp::draw(){
 	//
 	material.begin();
 	ofFill();
-	for (int i = 0; i < scene.size(); i++) {
-		if (objSelected() && scene[i] == selected[0])
+	for (auto obj : drawList) {
+		if (objSelected() && obj == selected[0])
 			ofSetColor(ofColor::purple);
-		else ofSetColor(scene[i]->diffuseColor);
-		scene[i]->draw();
+		else ofSetColor(obj->diffuseColor);
+		obj->draw();
 	}
 
 	material.end();
@@ -297,6 +487,41 @@ void ofApp::draw(){
 
 	ofDisableDepthTest();
 	gui.draw();
+	if (IKArm::numActive + IKArm::numParked + IKArm::numBlended > 0) {
+		ofSetColor(ofColor::white);
+		string cacheStats;
+		if (IKArm::useSolutionCache) { // Lookups across all the arms, since they were made
+			float hits = 0;
+			int lookups = 0;
+			for (auto obj : scene) {
+				if (IKArm* arm = dynamic_cast<IKArm*>(obj)) {
+					int armLookups = arm->solutionCache.hits + arm->solutionCache.misses;
+					hits += arm->solutionCache.hitRate() * armLookups;
+					lookups += armLookups;
+				}
+			}
+			if (lookups > 0) cacheStats = ", warm-start cache " + ofToString(100 * hits / lookups, 0) + "% hits of " + to_string(lookups);
+		}
+		ofDrawBitmapString("IK arms: " + to_string(IKArm::numActive) + " active, " + to_string(IKArm::numParked) + " parked, " +
+			to_string(IKArm::numBlended) + " between solves" + cacheStats, 10, gui.getHeight() + 30);
+		if (IKScheduler::enabled) {
+			ofDrawBitmapString("IK scheduler: " + to_string(ikScheduler.numScheduled) + " updated, " + to_string(ikScheduler.numWaiting) +
+				" waiting, staleness " + ofToString(ikScheduler.meanStaleness, 1) + " avg / " + to_string(ikScheduler.maxStaleness) + " max frames",
+				10, gui.getHeight() + 45);
+		}
+	}
+	if (showFrameStats) {
+		string stats = "Frame:";
+		for (auto &stage : framePipeline.getStages()) stats += " " + stage.name + " " + ofToString(stage.ms, 2);
+		stats += " ms, drawing " + to_string(drawList.size()) + " / " + to_string(scene.size()) + " objects";
+		ofSetColor(ofColor::white);
+		ofDrawBitmapString(stats, 10, ofGetHeight() - 40);
+	}
+	if (skeletonLoader.isBusy()) {
+		ofSetColor(ofColor::white);
+		ofDrawBitmapString("Loading " + to_string(skeletonLoader.numDone()) + " / " + to_string(skeletonLoader.numFiles()) + " files" +
+			string((ofGetFrameNum() / 10) % 4, '.'), 10, ofGetHeight() - 20);
+	}
 }
 
 // 
@@ -371,13 +596,27 @@ void ofApp::keyPressed(int key) {
 	case 'e':
 		handleToggleAnimationPause();
 		break;
+	case 'E':
+	{
+		ofFileDialogResult result = ofSystemSaveDialog("take.bvh", "Export motion (.bvh or .csv)");
+		if (result.bSuccess) exportMotion(result.getPath(), exportSeconds, exportRate);
+	}
+		break;
 	case 'C':
 	case 'c':
 		if (mainCam.getMouseInputEnabled()) mainCam.disableMouseInput();
 		else mainCam.enableMouseInput();
 		break;
 	case 'F':
+		break;
 	case 'b':
+		runIKBenchmark();
+		break;
+	case 't':
+		startTreeIK();
+		break;
+	case 'o':
+		spawnObstacle();
 		break;
 	case 'f':
 		ofToggleFullscreen();
@@ -568,10 +807,7 @@ void ofApp::gotMessage(ofMessage msg){
 
 //--------------------------------------------------------------
 void ofApp::dragEvent(ofDragInfo dragInfo){ 
-	if (dragInfo.files.size() == 1) {
-		string fileName = dragInfo.files[0];
-		loadFromFile(fileName);
-	}
+	if (!dragInfo.files.empty()) loadFromFiles(dragInfo.files);
 }
 
 
@@ -594,13 +830,15 @@ SceneObject* ofApp::findObjFromName(string name) {
 	for (auto obj : scene) {
 		if (obj->name == name) return obj;
 	}
+	return NULL;
 }
 
-void ofApp::spawnJoint(string name, glm::vec3 rot, glm::vec3 trans, Joint* parent = NULL) {
+Joint* ofApp::spawnJoint(string name, glm::vec3 rot, glm::vec3 trans, Joint* parent = NULL) {
 	glm::vec3 pos = { 0, 0, 0 }; // Spawn on top of either origin or parent
-	Joint* joint = new Joint(name, pos, rot, trans, parent);
-	scene.push_back(joint);
+	Joint* joint = Joint::pool.create(name, pos, rot, trans, parent);
+	addToScene(joint);
 	numJointsSpawned++;
+	return joint;
 }
 
 void ofApp::deleteSelected() {
@@ -617,148 +855,301 @@ void ofApp::deleteSelected() {
 				child->parent = NULL;
 			}
 		}
-		auto iteratorAtIndexOfObject = find(scene.begin(), scene.end(), selectedObj);
-		scene.erase(iteratorAtIndexOfObject);
+		if (newParentForChildren != NULL) newParentForChildren->removeChild(selectedObj);
+		removeFromScene(selectedObj);
 		selected.erase(selected.begin());
+		releaseObject(selectedObj);
 	}
 }
 
-void ofApp::saveToFile() {
-	if (scene.size() > 1) { // Need more than plane
-		string skeletonFileName = "skeleton.txt";
-		string cwd = ofFilePath::getCurrentWorkingDirectory();
-
-		cout << "Saving to file " << cwd << "\\" << skeletonFileName << "..." << endl;
-
-		ofstream write;
-		write.open(skeletonFileName);
-		// Format:
-		// create -joint joint name -rotate <x, y, z> -translate <x, y, z> -parent name; 
-		for (int i = 1; i < scene.size(); i++) { // Skip plane
-			SceneObject* curr = scene[i];
-			if (dynamic_cast<Joint*>(curr) != nullptr) { // Only write Joints - ignore all others for now
-				write << "create -joint " << curr->name
-					<< " -rotate <" << curr->rotation
-					<< "> -translate <" << curr->position << "> ";
-				if (curr->parent != NULL) {
-					write << "-parent " << curr->parent->name;
-				}
-				write << "\n";
-			}
-		}
-		write.close();
-		cout << "Done." << endl;
+// Hand an object back to the pool it came from.  Anything not from a pool (the ground
+// plane) is left alone.  IK arms and rigs notice through their handles if one of their
+// joints goes.
+void ofApp::releaseObject(SceneObject* obj) {
+	if (animation != nullptr) animation->removeObject(obj);
+	if (Joint* joint = dynamic_cast<Joint*>(obj)) {
+		if (Joint::pool.owns(joint)) Joint::pool.release(joint);
 	}
-	else {
+	else if (IKArm* arm = dynamic_cast<IKArm*>(obj)) {
+		if (IKArm::pool.owns(arm)) IKArm::pool.release(arm);
+	}
+	else if (IKTreeRig* rig = dynamic_cast<IKTreeRig*>(obj)) {
+		if (IKTreeRig::pool.owns(rig)) IKTreeRig::pool.release(rig);
+	}
+	else if (Sphere* sphere = dynamic_cast<Sphere*>(obj)) {
+		if (Sphere::pool.owns(sphere)) Sphere::pool.release(sphere);
+	}
+}
+
+// Snapshot the joints and write them out on the writer's thread, as text or as binary
+// (.skb) depending on the name picked
+void ofApp::saveToFile() {
+	SkeletonDesc skeleton;
+	describeScene(skeleton);
+	if (skeleton.joints.empty()) {
 		cout << "There's no skeleton to save." << endl;
+		return;
 	}
+	if (skeletonWriter.isBusy()) {
+		cout << "Still saving the last skeleton." << endl;
+		return;
+	}
+	ofFileDialogResult result = ofSystemSaveDialog("skeleton.txt", "Save skeleton (.txt, or .skb for binary)");
+	if (!result.bSuccess) return;
+	cout << "Saving to file " << result.getPath() << "..." << endl;
+	skeletonWriter.start(result.getPath(), std::move(skeleton));
 }
 
-void replaceAll(std::string & orig, std::string findStr, std::string replaceStr) // Helper
-{
-	size_t pos = orig.find(findStr);
-	while (pos != std::string::npos)
-	{
-		orig.replace(pos, findStr.size(), replaceStr);
-		pos = orig.find(findStr, pos + replaceStr.size());
+// Every joint in the scene, each after its parent (and the joints themselves, in the same order)
+void ofApp::describeScene(SkeletonDesc &skeleton, vector<Joint*> *joints) {
+	skeleton.joints.clear();
+	if (joints != NULL) joints->clear();
+	map<SceneObject*, int> index;
+	function<int(Joint*)> add = [&](Joint* joint) {
+		auto found = index.find(joint);
+		if (found != index.end()) return found->second;
+		Joint* parent = dynamic_cast<Joint*>(joint->parent);
+		int parentIndex = (parent != NULL && isInScene(parent)) ? add(parent) : -1;
+		JointDesc desc;
+		desc.name = joint->name;
+		desc.rotation = joint->rotation;
+		desc.translation = joint->position;
+		desc.parent = parentIndex;
+		desc.hasLimits = joint->hasLimits;
+		desc.minAngles = joint->minAngles;
+		desc.maxAngles = joint->maxAngles;
+		index[joint] = (int)skeleton.joints.size();
+		skeleton.joints.push_back(desc);
+		if (joints != NULL) joints->push_back(joint);
+		return index[joint];
+	};
+	for (auto obj : scene) {
+		Joint* joint = dynamic_cast<Joint*>(obj);
+		if (joint != NULL) add(joint);
 	}
 }
 
+void ofApp::addToScene(SceneObject* obj) {
+	obj->sceneIndex = scene.size();
+	scene.push_back(obj);
+}
+
+void ofApp::removeFromScene(SceneObject* obj) {
+	if (!isInScene(obj)) return;
+	SceneObject* last = scene.back();
+	scene[obj->sceneIndex] = last;
+	last->sceneIndex = obj->sceneIndex;
+	scene.pop_back();
+	obj->sceneIndex = -1;
+}
+
+// Everything but the ground plane goes, and the pools are emptied in one go.  Obstacle
+// shapes go too, since their ids are keyed by objects whose slots are about to be reused.
 void ofApp::clearScene() {
 	scene.erase(scene.begin() + 1, scene.end());
+	for (auto &entry : obstacleIds) obstacleField.removeShape(entry.second);
+	obstacleIds.clear();
 	selected.clear();
+	if (animation != nullptr) animation->reset(); // Nothing it drove is left
+	Joint::pool.clear();
+	Sphere::pool.clear();
+	IKArm::pool.clear();
+	IKTreeRig::pool.clear();
+	loadedFiles.clear();
+	pendingReloads.clear();
+	fileWatcher.clear();
 }
 
-void ofApp::loadFromFile(string filename) {
-	ifstream in(filename);
-	if (!in) {
-		cout << "Invalid file: " << filename << endl;
+// Parse the files in the background; finishLoading() puts them in the scene
+void ofApp::loadFromFiles(const vector<string> &filenames) {
+	if (!skeletonLoader.start(filenames)) {
+		cout << "Still loading the last files." << endl;
+		return;
 	}
-	else {
-		cout << "Loading from file: " << filename << endl;
+	loadingIsReload = false;
+	for (auto &filename : filenames) cout << "Loading from file: " << filename << endl;
+}
 
-		clearScene();
+// Once the whole batch has parsed, swap it in for the current skeleton in one go.  Files
+// that failed are reported and skipped; if none of them worked the scene is left alone.
+void ofApp::finishLoading() {
+	vector<LoadedSkeleton> loaded;
+	if (!skeletonLoader.poll(loaded)) return;
+	if (loadingIsReload) {
+		for (auto &file : loaded) {
+			if (loadedFiles.count(file.path) == 0) continue; // The scene was cleared while it parsed
+			if (!file.ok) {
+				cout << "Reload failed, keeping the current joints: " << file.error << endl;
+				continue;
+			}
+			if (file.binary != nullptr) binaryViewToDesc(file.binary->view(), file.skeleton);
+			applySkeletonDiff(file.path, file.skeleton);
+		}
+		return;
+	}
 
-		// Format:
-		// create -joint joint name -rotate <x, y, z> -translate <x, y, z> -parent name; 
-		string line;
-		while (getline(in, line)) {
-			string jointName;
-			glm::vec3 jointRot = { 0, 0, 0 };
-			glm::vec3 jointTrans = { 0, 0, 0 };
-			string parentName = "null";
-			Joint* jointParent = NULL;
-
-			string s1, s2;
-			float f1, f2, f3;
-			istringstream iss(line);
-			while (iss >> s1) {
-				if (s1 == "-joint") {
-					iss >> jointName;
-				}
-				else if (s1 == "-rotate") {
-					iss >> s2;
-					replaceAll(s2, ",", "");
-					replaceAll(s2, "<", "");
-					stringstream ss1(s2);
-					ss1 >> f1;
-
-					iss >> s2;
-					stringstream ss2(s2);
-					ss2 >> f2;
-					replaceAll(s2, ",", "");
-
-					iss >> s2;
-					replaceAll(s2, ",", "");
-					replaceAll(s2, ">", "");
-					stringstream ss3(s2);
-					ss3 >> f3;
-
-					jointRot = { f1, f2, f3 };
-				}
-				else if (s1 == "-translate") {
-					iss >> s2;
-					replaceAll(s2, ",", "");
-					replaceAll(s2, "<", "");
-					stringstream ss1(s2);
-					ss1 >> f1;
-
-					iss >> s2;
-					stringstream ss2(s2);
-					ss2 >> f2;
-					replaceAll(s2, ",", "");
-
-					iss >> s2;
-					replaceAll(s2, ",", "");
-					replaceAll(s2, ">", "");
-					stringstream ss3(s2);
-					ss3 >> f3;
-
-					jointTrans = { f1, f2, f3 };
-				}
-				else if (s1 == "-parent") {
-					iss >> parentName;
-				}
-			} // Ignore everything else for now
+	bool anyLoaded = false;
+	for (auto &file : loaded) {
+		if (!file.ok) cout << "Invalid file: " << file.error << endl;
+		anyLoaded = anyLoaded || file.ok;
+	}
+	if (!anyLoaded) return;
 
-			if (parentName != "null") {
-				SceneObject* obj = findObjFromName(parentName);
-				jointParent = dynamic_cast<Joint*>(obj);
+	clearScene();
+	int joints = 0;
+	SkeletonMotion* motion = NULL; // The first motion capture in the batch drives the animation
+	vector<Joint*> motionJoints;
+	for (auto &file : loaded) {
+		if (!file.ok) continue;
+		vector<Joint*> built;
+		if (file.binary != nullptr) { // built straight from the mapped arrays
+			built = buildSkeleton(file.binary->view());
+		}
+		else {
+			built = buildSkeleton(file.skeleton);
+			if (motion == NULL && file.motion.numFrames > 0) {
+				motion = &file.motion;
+				motionJoints = built;
 			}
+		}
+		joints += built.size();
+		vector<Joint::Handle> &handles = loadedFiles[file.path];
+		for (auto joint : built) handles.push_back(Joint::pool.handleOf(joint));
+		fileWatcher.watch(file.path);
+	}
+	if (motion != NULL) playMotion(motionJoints, move(*motion));
+	cout << "Diagnostic Info: " << endl;
+	cout << " - joints: " << joints << endl;
+}
+
+// Re-parse any loaded file that has been written since last frame.  Edits made while hot
+// reload is off are drained and dropped, so turning it on doesn't replay them all.
+void ofApp::checkForReloads() {
+	changedFiles.clear();
+	fileWatcher.poll(changedFiles);
+	if (!hotReload) {
+		pendingReloads.clear();
+		return;
+	}
+	for (auto &path : changedFiles) {
+		if (loadedFiles.count(path) == 0) continue;
+		if (find(pendingReloads.begin(), pendingReloads.end(), path) == pendingReloads.end()) pendingReloads.push_back(path);
+	}
+	if (pendingReloads.empty() || skeletonLoader.isBusy()) return;
+	for (auto &path : pendingReloads) cout << "Reloading " << path << endl;
+	skeletonLoader.start(pendingReloads);
+	loadingIsReload = true;
+	pendingReloads.clear();
+}
 
-			spawnJoint(jointName, jointRot, jointTrans, jointParent);
+// Bring the joints path made last time in line with its new contents.  Only that file's
+// own joints are candidates (other files may well use the same names), matched by name
+// (the nth joint of a name with the nth of that name); only changed
+// transforms, limits and parents are touched, so keyframes and IK arms that point at
+// the surviving joints keep working.  New joints are added (and keyed from the next
+// keyframe on), missing ones removed along with their keyframe tracks.
+void ofApp::applySkeletonDiff(const string &path, const SkeletonDesc &skeleton) {
+	vector<Joint::Handle> &handles = loadedFiles[path];
+	unordered_map<string, vector<Joint*>> live;
+	for (auto &handle : handles) {
+		Joint* joint = Joint::pool.get(handle); // NULL if it has been deleted since
+		if (joint != NULL) live[joint->name].push_back(joint);
+	}
+
+	int numChanged = 0, numAdded = 0;
+	unordered_map<string, int> used;
+	vector<Joint*> joints(skeleton.joints.size());
+	for (int i = 0; i < skeleton.joints.size(); i++) {
+		const JointDesc &desc = skeleton.joints[i];
+		Joint* parent = (desc.parent >= 0) ? joints[desc.parent] : NULL;
+		vector<Joint*> &candidates = live[desc.name];
+		int &next = used[desc.name];
+		if (next >= candidates.size()) {
+			joints[i] = spawnJoint(desc.name, desc.rotation, desc.translation, parent);
+			if (desc.hasLimits) joints[i]->setLimits(desc.minAngles, desc.maxAngles);
+			numAdded++;
+			continue;
+		}
+		Joint* joint = candidates[next++];
+		joints[i] = joint;
+		bool changed = false;
+		if (joint->rotation != desc.rotation || joint->position != desc.translation) {
+			joint->rotation = desc.rotation;
+			joint->position = desc.translation;
+			changed = true;
+		}
+		if (joint->hasLimits != desc.hasLimits || (desc.hasLimits && (joint->minAngles != desc.minAngles || joint->maxAngles != desc.maxAngles))) {
+			joint->hasLimits = desc.hasLimits;
+			joint->minAngles = desc.minAngles;
+			joint->maxAngles = desc.maxAngles;
+			changed = true;
+		}
+		if (joint->parent != parent) {
+			if (joint->parent != NULL) joint->parent->removeChild(joint);
+			if (parent != NULL) parent->addChild(joint);
+			changed = true;
+		}
+		if (changed) numChanged++;
+	}
+
+	// Whatever wasn't matched is gone from the file; its children go to its parent, as
+	// with deleteSelected()
+	unordered_set<SceneObject*> removed;
+	for (auto &entry : live) {
+		int kept = used[entry.first];
+		for (int i = kept; i < entry.second.size(); i++) removed.insert(entry.second[i]);
+	}
+	for (auto obj : removed) {
+		SceneObject* newParent = obj->parent;
+		while (newParent != NULL && removed.count(newParent)) newParent = newParent->parent;
+		for (auto child : obj->childList) {
+			if (removed.count(child)) continue;
+			child->parent = NULL;
+			if (newParent != NULL) newParent->addChild(child);
 		}
-		cout << "Diagnostic Info: " << endl;
-		cout << " - joints: " << scene.size() << endl;
+		if (obj->parent != NULL && !removed.count(obj->parent)) obj->parent->removeChild(obj);
+	}
+	if (!removed.empty()) {
+		auto isRemoved = [&](SceneObject* obj) { return removed.count(obj) > 0; };
+		for (auto obj : removed) removeFromScene(obj);
+		selected.erase(remove_if(selected.begin(), selected.end(), isRemoved), selected.end());
+		for (auto obj : removed) releaseObject(obj);
+	}
+
+	handles.clear();
+	for (auto joint : joints) handles.push_back(Joint::pool.handleOf(joint));
+	cout << "Reloaded " << path << ": " << numChanged << " changed, " << numAdded << " added, " << removed.size() << " removed" << endl;
+}
+
+// Spawn a joint for every entry (parents always come before their children)
+vector<Joint*> ofApp::buildSkeleton(const SkeletonDesc &skeleton) {
+	vector<Joint*> spawned(skeleton.joints.size());
+	scene.reserve(scene.size() + skeleton.joints.size());
+	for (int i = 0; i < skeleton.joints.size(); i++) {
+		const JointDesc &desc = skeleton.joints[i];
+		Joint* parent = (desc.parent >= 0) ? spawned[desc.parent] : NULL;
+		spawned[i] = spawnJoint(desc.name, desc.rotation, desc.translation, parent);
+		if (desc.hasLimits) spawned[i]->setLimits(desc.minAngles, desc.maxAngles);
 	}
-	in.close();
+	return spawned;
+}
+
+vector<Joint*> ofApp::buildSkeleton(const SkeletonBinaryView &skeleton) {
+	vector<Joint*> spawned(skeleton.jointCount);
+	scene.reserve(scene.size() + skeleton.jointCount);
+	for (int i = 0; i < skeleton.jointCount; i++) {
+		Joint* parent = (skeleton.parents[i] >= 0) ? spawned[skeleton.parents[i]] : NULL;
+		spawned[i] = spawnJoint(skeleton.name(i), skeleton.rotations[i], skeleton.translations[i], parent);
+		if (skeleton.hasLimits != NULL && skeleton.hasLimits[i]) spawned[i]->setLimits(skeleton.minAngles[i], skeleton.maxAngles[i]);
+	}
+	return spawned;
 }
 
 void Joint::draw() {
 
-	//   get the current transformation matrix for this object
+	//   get this frame's transformation for this object
    //
-	glm::mat4 m = getMatrix();
+	glm::mat4 m = world.toMat4();
 
 	//   push the current stack matrix and multiply by this object's
 	//   matrix. now all vertices dran will be transformed by this matrix
@@ -772,11 +1163,11 @@ void Joint::draw() {
 		ofPushMatrix();
 
 		glm::vec3 boneRot = { 0, 1, 0 }; // Default for OF
-		glm::vec3 boneToParent = parent->getPosition() - getPosition();
+		glm::vec3 boneToParent = parent->world.translation - world.translation;
 		float length = glm::length(boneToParent);
 		glm::mat4 rotationMatrix = rotateToVector(glm::normalize(boneRot), glm::normalize(boneToParent));
 
-		glm::mat4 translationMatrix = glm::translate(getPosition());
+		glm::mat4 translationMatrix = glm::translate(world.translation);
 		glm::mat4 offsetMiddleMatrix = glm::translate(glm::vec3(0, length / 2, 0));
 		ofMultMatrix(translationMatrix * rotationMatrix * offsetMiddleMatrix);
 
@@ -791,85 +1182,479 @@ void Joint::draw() {
 
 }
 
+void Joint::refitBounds() {
+	Sphere::refitBounds();
+	if (parent == NULL) return;
+	glm::vec3 boneToParent = parent->world.translation - world.translation;
+	boundsCenter = world.translation + boneToParent / 2;
+	boundsRadius += glm::length(boneToParent) / 2;
+}
+
 // IK Stuff
+ofParameter<int> IKArm::optimizer{ "Optimizer (fixed/mom/adam)", 1, 0, 2 };
 ofParameter<float> IKArm::learningRate{ "Learning rate", 100, 0, 1000 };
 ofParameter<float> IKArm::deltaRotation{ "Delta rotation", 5, 0, 50 };
 ofParameter<float> IKArm::distThreshold{ "Distance threshold", 0.3, 0, 10 };
+ofParameter<bool> IKArm::useReachabilityMap{ "Reachability map", false };
+ofParameter<bool> IKArm::useSolutionCache{ "Warm-start cache", true };
+ofParameter<bool> IKArm::avoidObstacles{ "Avoid obstacles", false };
+ofParameter<float> IKArm::obstacleMargin{ "Obstacle margin", 0.5, 0, 2 };
+ofParameter<bool> IKArm::useMultiStart{ "Multi-start on stall", false };
+ofParameter<int> IKArm::multiStartSeeds{ "Multi-start seeds", 8, 2, 32 };
+ofParameter<int> IKArm::parallelMinJoints{ "Parallel gradient from (joints)", 512, 16, 4096 };
+atomic<int> IKArm::numActive{ 0 };
+atomic<int> IKArm::numParked{ 0 };
+atomic<int> IKArm::numBlended{ 0 };
+ofParameter<float> IKArm::defaultSolveRate{ "IK rate (Hz, 0 = every frame)", 0, 0, 120 };
+ofParameter<bool> IKArm::extrapolatePoses{ "Extrapolate between solves", false };
+
+// A solve has stalled once this many steps go by without getting 1% closer
+static const int stallWindow = 20;
+static const int multiStartIterations = 300; // Step budget per seed
+static const int bestEffortIterations = 50; // Step budget for targets the envelope or map rules out
+
+Transform IKArm::getBaseTransform() {
+	if (joints[0]->parent != NULL) return joints[0]->parent->getTransform();
+	else return Transform();
+}
 
-// Test where the endjoint goes after a series of rotations starting from current joint rotations
-glm::vec3 IKArm::simulateRotations(vector<float> jointAngles) {
-	glm::mat4 sim(1.0f);
-	for(int i = 0; i < joints.size(); i++) {
+bool IKArm::gatherChain() {
+	bool changed = false;
+	for (int i = 0; i < joints.size(); i++) {
 		auto joint = joints[i];
-		auto angle = jointAngles[i];
+		ChainLink link;
+		link.position = joint->position;
+		link.scale = joint->scale;
+		link.pivot = joint->pivot;
+		link.axis = joint->lockedAxis;
+		link.minAngle = joint->minAngle(link.axis);
+		link.maxAngle = joint->maxAngle(link.axis);
+		if (link != chain->getLink(i)) changed = true;
+		chain->setLink(i, link, joint->lockedAngle());
+	}
+	if (changed) {
+		envelope = ReachEnvelope::compute(*chain);
+		reachMap.clear();
+		solutionCache.clear();
+	}
+	return changed;
+}
 
-		glm::vec3 rotationCopy = joint->rotation;
-		rotationCopy = joint->lockedAxis * angle;
-		glm::mat4 changedRotation = glm::eulerAngleYXZ(glm::radians(rotationCopy.y), glm::radians(rotationCopy.x), glm::radians(rotationCopy.z));
-		//glm::mat4 changedRotation = joint->getRotateMatrix();
+void IKArm::scatterChain() {
+	for (int i = 0; i < joints.size(); i++) {
+		joints[i]->lockedAngle() = chain->getAngle(i);
+	}
+}
 
-		// get the local transformations + pivot
-		//
-		glm::mat4 scale = joint->getScaleMatrix();
-		glm::mat4 trans = joint->getTranslateMatrix();
+// Move the arm towards the set target
+void IKArm::moveTowardsTarget() {
+	gatherChain();
+	Transform base = getBaseTransform();
+	glm::vec3 targetPos = target->getPosition();
+
+	// Shoulder-elbow-wrist shaped chains have a closed form - solve them in one go,
+	// unless that pose breaks a joint limit (or obstacles need steering round) and the
+	// iterative solver has to find another
+	bool useObstacles = avoidObstacles && obstacles != NULL && !obstacles->isEmpty();
+	if (isTwoBoneChain(*chain) && !useObstacles) {
+		Joint* poleJoint = getPole();
+		glm::vec3 polePos = (poleJoint != NULL) ? poleJoint->getPosition() : joints[2]->getPosition();
+		TwoBoneResult result = solveTwoBone(*chain, base, targetPos, polePos);
+		if (result.withinLimits) {
+			for (int i = 0; i < 3; i++) chain->setAngle(i, result.angles[i]);
+			targetReachable = result.reachable;
+			solving = false;
+			scatterChain();
+			park(base, targetPos);
+			return;
+		}
+	}
 
-		// handle pivot point  (rotate around a point that is not the object's center)
-		//
-		glm::mat4 pre = glm::translate(glm::mat4(1.0), glm::vec3(-joint->pivot.x, -joint->pivot.y, -joint->pivot.z));
-		glm::mat4 post = glm::translate(glm::mat4(1.0), glm::vec3(joint->pivot.x, joint->pivot.y, joint->pivot.z));
+	// Targets we can't get to only get a short best-effort solve.  The map is a
+	// conservative voxel approximation, so a miss there may still be reachable.
+	glm::vec3 localTarget = base.inverse().transformPoint(targetPos);
+	Reach reach = envelope.classify(localTarget);
+	bool mapMiss = false;
+	if (reach == Reach::Inside && useReachabilityMap) {
+		if (!reachMap.isBuilt()) reachMap.build(*chain, envelope);
+		mapMiss = !reachMap.mayReach(localTarget);
+	}
+	targetReachable = (reach == Reach::Inside && !mapMiss);
+	if (reach == Reach::TooFar) {
+		if (stretchTowards(*chain, localTarget)) { // Best we can do is point straight at it
+			scatterChain();
+			solving = false;
+			park(base, targetPos);
+			return;
+		}
+	}
+	bool bestEffort = !targetReachable; // Too close folds the chain as near as it will go
+
+	// Target moved since we last converged - this is a new solve
+	if (!solving) {
+		float dist = glm::distance(chain->endPosition(base), targetPos);
+		if (dist < distThreshold) {
+			park(base, targetPos);
+			return;
+		}
+		solving = true;
+		solveIterations = 0;
+		stallBestDist = dist;
+		stallSteps = 0;
+		chain->resetOptimizer();
+		if (useSolutionCache) warmStart(localTarget, base, targetPos, dist);
+	}
+
+	IKStepParams params = { learningRate, deltaRotation, distThreshold, (IKOptimizer)optimizer.get() };
+	params.pool = &ThreadPool::shared();
+	params.parallelMinJoints = parallelMinJoints;
+	if (useObstacles) {
+		params.obstacles = obstacles;
+		params.obstacleMargin = obstacleMargin;
+	}
+	if (chain->step(base, targetPos, params)) {
+		solveIterations++;
+		if (bestEffort && solveIterations >= bestEffortIterations) { // As close as it's worth getting
+			scatterChain();
+			solving = false;
+			lastSolveIterations = solveIterations;
+			park(base, targetPos);
+			return;
+		}
+		if (useMultiStart && !bestEffort) { // Stuck in a local minimum? Try again from elsewhere
+			float dist = glm::distance(chain->endPosition(base), targetPos);
+			if (dist < stallBestDist * 0.99f) {
+				stallBestDist = dist;
+				stallSteps = 0;
+			}
+			else if (++stallSteps >= stallWindow) {
+				stallBestDist = multiStart.solve(*chain, base, targetPos, params, multiStartSeeds, multiStartIterations, &ThreadPool::shared());
+				stallSteps = 0;
+			}
+		}
+		scatterChain(); // Apply calculated rotation angles to joints
+	}
+	else { // Converged - remember how we got here
+		solving = false;
+		lastSolveIterations = solveIterations;
+		if (useSolutionCache) {
+			for (int i = 0; i < joints.size(); i++) scratchAngles[i] = chain->getAngle(i);
+			solutionCache.insert(localTarget, scratchAngles.data(), joints.size());
+		}
+		park(base, targetPos);
+	}
+}
+
+function<float()> IKArm::clock = ofGetElapsedTimef;
+ObjectPool<IKArm> IKArm::pool;
+ObjectPool<Joint> Joint::pool;
+ObjectPool<Sphere> Sphere::pool;
+
+void IKArm::update() {
+	if (!jointsAlive()) return;
+	float now = clock();
+	float rate = getSolveRate();
+	if (rate > 0 && now - solveTime < 1 / rate) { // Not due yet
+		numBlended++;
+		showBlendedPose(now);
+		return;
+	}
+	if (showingBlend) { // The solver carries on from its own answer, not from the blend
+		setAngles(solvedAngles);
+		showingBlend = false;
+	}
+
+	if (parked && !inputsChanged()) {
+		numParked++;
+	}
+	else {
+		parked = false;
+		numActive++;
+		moveTowardsTarget();
+	}
+	recordSolution(now);
+}
+
+void IKArm::recordSolution(float time) {
+	swap(previousAngles, solvedAngles);
+	getAngles(solvedAngles);
+	previousSolveTime = solveTime;
+	solveTime = time;
+}
+
+// As if the arm were new: the next update solves from the joints as they are now, whatever
+// clock the old solve times came from
+void IKArm::restart() {
+	getAngles(solvedAngles);
+	previousAngles = solvedAngles;
+	solveTime = 0;
+	previousSolveTime = 0;
+	showingBlend = false;
+	parked = false;
+	solving = false;
+}
+
+// Interpolating eases from the previous solution into the last one over a solve interval,
+// so the arm shows each solution one interval late.  Extrapolating keeps going the way
+// the last two solutions went, for up to one interval, so it's on time but can overshoot.
+void IKArm::showBlendedPose(float time) {
+	float interval = solveTime - previousSolveTime;
+	if (interval <= 0) return;
+	float t = ofClamp((time - solveTime) / interval, 0, 1);
+	for (int i = 0; i < joints.size(); i++) {
+		float from = extrapolatePoses ? solvedAngles[i] : previousAngles[i];
+		float angle = from + (solvedAngles[i] - previousAngles[i]) * t;
+		Joint* joint = joints[i];
+		joint->lockedAngle() = ofClamp(angle, joint->minAngle(joint->lockedAxis), joint->maxAngle(joint->lockedAxis));
+	}
+	showingBlend = true;
+}
+
+void IKArm::park(const Transform &base, const glm::vec3 &targetPos) {
+	parked = true;
+	parkedBase = base;
+	parkedTarget = targetPos;
+	if (Joint* poleJoint = getPole()) parkedPole = poleJoint->getPosition();
+	if (obstacles != NULL) parkedObstacleVersion = obstacles->getVersion();
+}
 
+// The chain still holds what it last gathered/solved, so it doubles as the snapshot of the joints
+bool IKArm::inputsChanged() {
+	if (target->getPosition() != parkedTarget || getBaseTransform() != parkedBase) return true;
+	if (Joint* poleJoint = getPole()) {
+		if (isTwoBoneChain(*chain) && poleJoint->getPosition() != parkedPole) return true;
+	}
+	if (avoidObstacles && obstacles != NULL && obstacles->getVersion() != parkedObstacleVersion) return true;
+	for (int i = 0; i < joints.size(); i++) {
+		auto joint = joints[i];
+		const ChainLink &link = chain->getLink(i);
+		if (joint->position != link.position || joint->scale != link.scale || joint->pivot != link.pivot ||
+			joint->lockedAxis != link.axis || joint->lockedAngle() != chain->getAngle(i) ||
+			joint->minAngle(link.axis) != link.minAngle || joint->maxAngle(link.axis) != link.maxAngle) return true;
+	}
+	return false;
+}
+
+// Swap in the closest cached solution if it starts nearer the target than the current pose
+void IKArm::warmStart(const glm::vec3 &localTarget, const Transform &base, const glm::vec3 &targetPos, float currentDist) {
+	const IKSolutionCache::Entry *entry = solutionCache.lookup(localTarget);
+	if (entry == NULL || entry->angles.size() != joints.size()) return;
+
+	for (int i = 0; i < joints.size(); i++) {
+		scratchAngles[i] = chain->getAngle(i);
+		chain->setAngle(i, entry->angles[i]);
+	}
+	if (glm::distance(chain->endPosition(base), targetPos) < currentDist) {
+		scatterChain();
+	}
+	else {
+		for (int i = 0; i < joints.size(); i++) chain->setAngle(i, scratchAngles[i]);
+	}
+}
 
+// Tree IK
+ofParameter<float> IKTreeRig::damping{ "Tree IK damping", 0.5, 0.01, 5 };
+ObjectPool<IKTreeRig> IKTreeRig::pool;
+
+IKTreeRig::IKTreeRig(Joint* root) {
+	isSelectable = false;
+	joints.push_back(root);
+	for (int i = 0; i < joints.size(); i++) { // Breadth first, so parents always come first
+		handles.push_back(Joint::pool.handleOf(joints[i]));
+		for (auto child : joints[i]->childList) {
+			Joint* childJoint = dynamic_cast<Joint*>(child);
+			if (childJoint != nullptr) joints.push_back(childJoint);
+		}
+	}
+	for (int i = 0; i < joints.size(); i++) {
+		IKTreeNode node;
+		for (int p = 0; p < i; p++) {
+			if (joints[p] == joints[i]->parent) node.parent = p;
+		}
+		tree.addNode(node);
+	}
+	gatherTree();
+}
 
-		sim *= (trans * post * changedRotation * pre * scale);
+void IKTreeRig::addEffector(Joint* joint, Joint* target, float weight) {
+	int node = find(joints.begin(), joints.end(), joint) - joints.begin();
+	if (node == joints.size()) return;
+	tree.addEffector(node, weight);
+	targets.push_back(target);
+	handles.push_back(Joint::pool.handleOf(target));
+}
 
-		//sim *= joint->getLocalMatrix();
+void IKTreeRig::gatherTree() {
+	for (int i = 0; i < joints.size(); i++) {
+		auto joint = joints[i];
+		IKTreeNode &node = tree.getNode(i);
+		if (node.parent < 0) node.base = (joint->parent != NULL) ? joint->parent->getTransform() : Transform();
+		node.position = joint->position;
+		node.rotation = joint->rotation;
+		node.scale = joint->scale;
+		node.pivot = joint->pivot;
+		tree.setAxisMask(i, joint->axisIsLocked ? 1 << (int)joint->lockedAxis : 7);
+		for (int axis = 0; axis < 3; axis++) {
+			node.minAngles[axis] = joint->minAngle((JointAxis)axis);
+			node.maxAngles[axis] = joint->maxAngle((JointAxis)axis);
+		}
 	}
+	for (int e = 0; e < targets.size(); e++) {
+		tree.getEffector(e).target = targets[e]->getPosition();
+	}
+}
 
-	return sim * glm::vec4(0.0, 0.0, 0.0, 1.0);
+void IKTreeRig::scatterTree() {
+	for (int i = 0; i < joints.size(); i++) {
+		joints[i]->rotation = tree.getNode(i).rotation;
+	}
 }
 
-// Return how close we are, using given joint angles - will be used as error function to minimize for gradient descent
-float IKArm::distanceToTarget(vector<float> jointAngles) {
-	glm::vec3 pt = simulateRotations(jointAngles); // End joints position after applying given angles
-	return glm::distance(pt, target->getPosition());
+// One damped least squares step for all limbs per frame
+void IKTreeRig::update() {
+	if (!Joint::allAlive(handles)) return; // A joint or target was deleted
+	gatherTree();
+	IKTreeParams params;
+	params.damping = damping;
+	params.distThreshold = IKArm::distThreshold;
+	if (tree.step(params)) scatterTree();
 }
 
-// Computes gradient for a particular joint
-// ( ( F(x + deltaRotation) - F(x) ) / deltaRotation ), where F is our error function
-float IKArm::gradient(vector<float> jointAngles, int jointIndex) {
-	float fX = distanceToTarget(jointAngles);
-	jointAngles[jointIndex] += deltaRotation;
-	float fXPlusDelta = distanceToTarget(jointAngles);
-	float gradient = (fXPlusDelta - fX) / deltaRotation;
-	return gradient;
+// Put a target on every leaf of the selected joint's skeleton and solve them together
+void ofApp::startTreeIK() {
+	if (!objSelected()) return;
+	Joint* root = dynamic_cast<Joint*>(selected[0]);
+	if (root == nullptr) return;
+	while (dynamic_cast<Joint*>(root->parent) != nullptr) root = dynamic_cast<Joint*>(root->parent);
+
+	IKTreeRig* rig = IKTreeRig::pool.create(root);
+	for (auto joint : rig->joints) {
+		if (joint == root) continue;
+		bool isLeaf = true;
+		for (auto child : joint->childList) {
+			if (dynamic_cast<Joint*>(child) != nullptr) isLeaf = false;
+		}
+		if (!isLeaf) continue;
+
+		glm::vec3 rot = { 0, 0, 0 };
+		glm::vec3 trans = { 0, 0, 0 };
+		Joint* target = Joint::pool.create(joint->name + "Target", joint->getPosition(), rot, trans);
+		target->diffuseColor = ofColor::blue;
+		addToScene(target);
+		rig->addEffector(joint, target);
+	}
+	addToScene(rig);
+	cout << "Tree IK on " << root->name << ": " << rig->joints.size() << " joints, " << rig->targets.size() << " targets" << endl;
 }
 
-// Move the arm towards the set target
-void IKArm::moveTowardsTarget() {
-	/*cout << "Positions:" << endl;
-	for (auto joint : joints) cout << joint->getPosition() << endl;*/
-	vector<float> angles = getAngles();
-	/*cout << "Angles:" << endl;
-	for(auto angle : angles) cout << angle << endl;*/
-
-	/*cout << "Target Position:" << endl;
-	cout << target->getPosition() << endl;*/
-	float dist = distanceToTarget(angles);
-	//cout << "Dist: " << dist << endl;
-	if (dist < distThreshold) return; // Stop moving if we're close enough
-
-	// Loop over all joints
-	/*cout << "Angles before:" << endl;
-	for(auto angle : angles) cout << angle << endl;*/
-	for (int i = joints.size()-1; i >= 0; i--) {
-		// Update the angles of each joint according to their individual gradients
-		float individualGradient = gradient(angles, i);
-		angles[i] -= learningRate * individualGradient;
-		if (distanceToTarget(angles) < distThreshold) return; // Stop moving if we're close enough
-	}
-	/*cout << "Angles after:" << endl;
-	for (auto angle : angles) cout << angle << endl;*/
-	setAngles(angles); // Apply calculated rotation angles to joints
+// IK scheduling
+ofParameter<bool> IKScheduler::enabled{ "IK scheduler", false };
+ofParameter<float> IKScheduler::budgetMs{ "IK budget (ms/frame)", 4, 0.1, 33 };
+
+// 1 at the camera, falling off with distance; selected arms count four times as much
+float IKScheduler::importance(IKArm* arm, glm::vec3 cameraPos, const vector<SceneObject*> &selected) {
+	float weight = 1 / (1 + glm::distance(arm->target->getPosition(), cameraPos) / 10);
+	for (auto obj : selected) {
+		if (obj == arm->target || find(arm->joints.begin(), arm->joints.end(), obj) != arm->joints.end()) {
+			weight *= 4;
+			break;
+		}
+	}
+	return weight;
+}
+
+void IKScheduler::run(const vector<IKArm*> &arms, glm::vec3 cameraPos, const vector<SceneObject*> &selected) {
+	uint64_t start = ofGetElapsedTimeMicros();
+	numScheduled = 0;
+
+	// Parked arms cost next to nothing, so they never wait
+	for (int i = 0; i < arms.size(); i++) {
+		IKArm* arm = arms[i];
+		if (arm->parked && !arm->inputsChanged()) {
+			arm->update();
+			arm->framesSinceUpdate = 0;
+			continue;
+		}
+		float error = glm::distance(arm->joints.back()->getPosition(), arm->target->getPosition());
+		float priority = (error + IKArm::distThreshold) * importance(arm, cameraPos, selected) * (1 + arm->framesSinceUpdate);
+		ready.push(make_pair(priority, i));
+	}
+
+	// Always at least one, so a tiny budget still makes progress
+	while (!ready.empty() && (numScheduled == 0 || ofGetElapsedTimeMicros() - start < budgetMs * 1000)) {
+		IKArm* arm = arms[ready.top().second];
+		ready.pop();
+		arm->update();
+		arm->framesSinceUpdate = 0;
+		numScheduled++;
+	}
+	numWaiting = ready.size();
+	while (!ready.empty()) {
+		IKArm* arm = arms[ready.top().second];
+		ready.pop();
+		arm->framesSinceUpdate++;
+		arm->maxFramesSinceUpdate = max(arm->maxFramesSinceUpdate, arm->framesSinceUpdate);
+	}
+
+	int total = 0;
+	maxStaleness = 0;
+	for (auto arm : arms) {
+		total += arm->framesSinceUpdate;
+		maxStaleness = max(maxStaleness, arm->framesSinceUpdate);
+	}
+	meanStaleness = arms.empty() ? 0 : (float)total / arms.size();
+}
+
+// Obstacles
+void ofApp::updateObstacles() {
+	if (!obstacleField.isSetup()) { // Room for the arms to move about over the ground plane
+		obstacleField.setup(glm::vec3(-15, -3, -15), glm::vec3(15, 15, 15), 0.25, 2);
+	}
+
+	auto byObject = [](const pair<SceneObject*, int> &a, const pair<SceneObject*, int> &b) { return a.first < b.first; };
+	obstacleIdsNext.clear();
+	for (auto obj : scene) {
+		if (dynamic_cast<Joint*>(obj) != nullptr) continue; // Joints and IK targets are what moves, not what's in the way
+		SDFShape shape;
+		shape.transform = obj->getTransform();
+		if (Cube* cube = dynamic_cast<Cube*>(obj)) {
+			shape.type = SDFShape::Box;
+			shape.size = glm::vec3(cube->width, cube->height, cube->depth) / 2;
+		}
+		else if (Sphere* sphere = dynamic_cast<Sphere*>(obj)) {
+			shape.type = SDFShape::Sphere;
+			shape.size = glm::vec3(sphere->radius, 0, 0);
+		}
+		else if (Cone* cone = dynamic_cast<Cone*>(obj)) { // Its bounding cylinder
+			shape.type = SDFShape::Cylinder;
+			shape.size = glm::vec3(cone->radius, cone->height, 0);
+		}
+		else if (Plane* ground = dynamic_cast<Plane*>(obj)) {
+			shape.type = SDFShape::HalfSpace;
+			shape.transform = Transform(glm::rotation(glm::vec3(0, 1, 0), glm::normalize(ground->normal)), ground->position);
+		}
+		else continue;
+
+		auto found = lower_bound(obstacleIds.begin(), obstacleIds.end(), make_pair(obj, 0), byObject);
+		if (found == obstacleIds.end() || found->first != obj) obstacleIdsNext.emplace_back(obj, obstacleField.addShape(shape));
+		else {
+			obstacleField.updateShape(found->second, shape);
+			obstacleIdsNext.emplace_back(obj, found->second);
+			found->second = -1; // Still in the scene
+		}
+	}
+	for (auto &entry : obstacleIds) { // Deleted since last frame
+		if (entry.second >= 0) obstacleField.removeShape(entry.second);
+	}
+	sort(obstacleIdsNext.begin(), obstacleIdsNext.end(), byObject);
+	swap(obstacleIds, obstacleIdsNext);
+	if (obstacleField.needsRebuild()) obstacleField.rebuild();
+}
+
+void ofApp::spawnObstacle() {
+	Sphere* obstacle = Sphere::pool.create(glm::vec3(2, 3, 0), 1, ofColor::orange);
+	obstacle->name = "obstacle";
+	addToScene(obstacle);
 }
 
 // Spawn IK arm and target
@@ -881,21 +1666,81 @@ void ofApp::startIK() {
 	glm::vec3 rot = { 0, 0, 0 };
 	glm::vec3 trans = { 0, 0, 0 };
 	glm::vec3 pos = { 0, -1.5, 0 }; 
-	Joint* joint1 = new Joint("baseJoint", pos, rot, trans);
+	Joint* joint1 = Joint::pool.create("baseJoint", pos, rot, trans);
 	pos = { .01, 2, 0 };
-	Joint* joint2 = new Joint("midJoint", pos, rot, trans, joint1);
+	Joint* joint2 = Joint::pool.create("midJoint", pos, rot, trans, joint1);
 	pos = { 1, 3, 0 };
-	Joint* joint3 = new Joint("endJoint", pos, rot, trans, joint2);
-	Joint* joint4 = new Joint("endJoint", pos, rot, trans, joint3);
+	Joint* joint3 = Joint::pool.create("endJoint", pos, rot, trans, joint2);
+	Joint* joint4 = Joint::pool.create("endJoint", pos, rot, trans, joint3);
 	vector<Joint*> joints = { joint1, joint2, joint3, joint4 };
 
 	pos = { 0, 6, 0 };
-	Joint* target = new Joint("target", pos, rot, trans);
+	Joint* target = Joint::pool.create("target", pos, rot, trans);
 	target->diffuseColor = ofColor::blue;
-	IKArm* ikArm = new IKArm(joints, target);
-	scene.push_back(target);
-	scene.push_back(ikArm);
-	for (auto joint : joints) scene.push_back(joint);
+	IKArm* ikArm = IKArm::pool.create(joints, target);
+	ikArm->obstacles = &obstacleField;
+	addToScene(target);
+
+	// Drag this to pick which way the elbow bends; delete it to keep the elbow where it is
+	pos = { 4, 3.5, 0 };
+	Joint* pole = Joint::pool.create("pole", pos, rot, trans);
+	pole->diffuseColor = ofColor::green;
+	ikArm->setPole(pole);
+	addToScene(pole);
+	addToScene(ikArm);
+	for (auto joint : joints) addToScene(joint);
+}
+
+
+// Solve random reachable targets with each optimizer on chains of different lengths and
+// report how many steps it takes to get within the distance threshold
+void ofApp::runIKBenchmark() {
+	const int chainLengths[] = { 3, 4, 7, 12, 30 };
+	const char *optimizerNames[] = { "fixed", "momentum", "adam" };
+	const int trials = 50;
+	const int maxIterations = 2000;
+
+	cout << "IK benchmark (threshold " << IKArm::distThreshold << ", " << trials << " targets per row)" << endl;
+	for (int n : chainLengths) {
+		unique_ptr<IKChainSolver> chain = makeIKChain(n);
+		for (int opt = 0; opt < 3; opt++) {
+			IKStepParams params = { IKArm::learningRate, IKArm::deltaRotation, IKArm::distThreshold, (IKOptimizer)opt };
+			params.pool = &ThreadPool::shared();
+			params.parallelMinJoints = IKArm::parallelMinJoints;
+			int totalIterations = 0, failures = 0, rescued = 0;
+			MultiStartIK multiStart;
+			float totalSeconds = 0;
+			ofSeedRandom(n);
+			for (int t = 0; t < trials; t++) {
+				// Same layout as startIK: yaw base, Z hinges, total length ~6
+				for (int i = 0; i < n; i++) {
+					ChainLink link;
+					link.position = (i == 0) ? glm::vec3(0, 0, 0) : glm::vec3(0.01, 6.0 / n, 0);
+					link.axis = (i == 0) ? JointAxis::Y : JointAxis::Z;
+					chain->setLink(i, link, ofRandom(-180, 180));
+				}
+				glm::vec3 target = chain->endPosition(Transform()); // Reachable by construction
+				for (int i = 0; i < n; i++) chain->setAngle(i, ofRandom(-60, 60));
+				chain->resetOptimizer();
+
+				float start = ofGetElapsedTimef();
+				int iterations = 0;
+				while (iterations < maxIterations && chain->step(Transform(), target, params)) iterations++;
+				if (iterations >= maxIterations) {
+					failures++;
+					if (IKArm::useMultiStart && multiStart.solve(*chain, Transform(), target, params, IKArm::multiStartSeeds,
+						multiStartIterations, &ThreadPool::shared()) < IKArm::distThreshold) rescued++;
+				}
+				totalSeconds += ofGetElapsedTimef() - start;
+				totalIterations += iterations;
+			}
+			cout << " - " << n << " joints, " << optimizerNames[opt] << ": " << (float)totalIterations / trials
+				<< " iterations to threshold, " << failures << " not converged";
+			if (IKArm::useMultiStart) cout << " (" << rescued << " rescued by multi-start)";
+			cout << ", "
+				<< totalSeconds * 1000 / trials << " ms per solve" << endl;
+		}
+	}
 }
 
 
@@ -903,10 +1748,15 @@ void ofApp::startIK() {
 ofParameter<float> Animation::lengthInSeconds{ "Animation length (s)", 1, 0.1, 10 };
 
 void Animation::start() {
-	if (keyFrames.size() >= 2) {
+	if (motion.numFrames > 0) {
+		paused = false;
+		timeAtLastKeyFrame = clock(); // When playback started
+		sampleMotion();
+	}
+	else if (keyFrames.size() >= 2) {
 		paused = false;
 		hasReachedKeyFrame = false;
-		timeAtLastKeyFrame = ofGetElapsedTimef();
+		timeAtLastKeyFrame = clock();
 		currentFrameIdx = 0;
 		nextFrameIdx = 1;
 		applyStartKeyFrame();
@@ -915,6 +1765,9 @@ void Animation::start() {
 
 void Animation::reset() {
 	keyFrames.clear();
+	tracks.clear();
+	motion = SkeletonMotion();
+	motionJoints.clear();
 	paused = true;
 	hasReachedKeyFrame = false;
 }
@@ -926,7 +1779,20 @@ void Animation::togglePause() {
 
 // Interpolate between keyframes to create an animation using the SceneObjects in each keyframe
 void Animation::update() {
-	if (!paused && keyFrames.size() >= 2) {
+	if (paused) return;
+	if (motion.numFrames > 0) {
+		sampleMotion();
+		return;
+	}
+	if (keyFrames.size() >= 2) {
+		// More than a keyframe behind (a slow frame, or keyframes closer together than
+		// frames): skip the ones that have already gone by
+		int behind = (int)(getTimeSinceLastKeyFrame() / getTimePerKeyFrame());
+		if (behind > 1) {
+			nextFrameIdx = (nextFrameIdx + behind - 1) % keyFrames.size();
+			currentFrameIdx = nextFrameIdx;
+			timeAtLastKeyFrame += (behind - 1) * getTimePerKeyFrame();
+		}
 		animate();
 		if (hasReachedKeyFrame) {
 			hasReachedKeyFrame = false;
@@ -938,9 +1804,9 @@ void Animation::update() {
 }
 
 void Animation::applyStartKeyFrame() {
-	KeyFrame startKeyFrame = keyFrames[0];
-	for (int i = 0; i < liveScene->size(); i++) {
-		auto liveObj = (*liveScene)[i];
+	const KeyFrame &startKeyFrame = keyFrames[0];
+	for (int i = 0; i < tracks.size(); i++) {
+		auto liveObj = tracks[i];
 		glm::vec3 startPosition = startKeyFrame.scene[i].position;
 		glm::vec3 startRotation = startKeyFrame.scene[i].rotation;
 		liveObj->position = startPosition;
@@ -949,10 +1815,10 @@ void Animation::applyStartKeyFrame() {
 }
 
 void Animation::animate() {
-	KeyFrame lastKeyFrame = keyFrames[currentFrameIdx];
-	KeyFrame nextKeyFrame = keyFrames[nextFrameIdx];
-	for (int i = 0; i < liveScene->size(); i++) {
-		auto liveObj = (*liveScene)[i];
+	const KeyFrame &lastKeyFrame = keyFrames[currentFrameIdx];
+	const KeyFrame &nextKeyFrame = keyFrames[nextFrameIdx];
+	for (int i = 0; i < tracks.size(); i++) {
+		auto liveObj = tracks[i];
 		//auto lastKeyFrameObj = lastKeyFrame.scene[i];
 		auto nextKeyFrameObj = nextKeyFrame.scene[i];
 		glm::vec3 livePosition = liveObj->position;
@@ -970,23 +1836,145 @@ void Animation::animate() {
 		
 		if (interp >= 1) {
 			hasReachedKeyFrame = true;
-			timeAtLastKeyFrame = ofGetElapsedTimef();
+			timeAtLastKeyFrame = clock();
 		}
 	}
 }
 
+void Animation::setMotion(const vector<Joint*> &joints, SkeletonMotion &&motion_) {
+	reset();
+	motion = move(motion_);
+	if (motion.frameTime <= 0) motion.frameTime = 1 / 30.0f;
+	timeAtLastKeyFrame = clock();
+	for (auto joint : joints) motionJoints.push_back(Joint::pool.handleOf(joint));
+}
+
+// The pose at the current time, between the two nearest capture frames; loops
+void Animation::sampleMotion() {
+	float frames = max(0.0f, (clock() - timeAtLastKeyFrame) / motion.frameTime);
+	float position = fmodf(frames, (float)motion.numFrames);
+	int frame = min((int)position, motion.numFrames - 1);
+	int next = (frame + 1) % motion.numFrames;
+	float t = position - frame;
+	for (int j = 0; j < motionJoints.size() && j < motion.numJoints; j++) {
+		Joint* joint = Joint::pool.get(motionJoints[j]);
+		if (joint == NULL) continue;
+		joint->rotation = lerp(motion.rotation(frame, j), motion.rotation(next, j), t);
+		joint->position = lerp(motion.translation(frame, j), motion.translation(next, j), t);
+	}
+}
+
 void Animation::addFrameFromScene() {
-	KeyFrame newFrame(*liveScene);
-	keyFrames.push_back(newFrame);
+	if (motion.numFrames > 0) { // Keyframing again replaces the motion capture
+		motion = SkeletonMotion();
+		motionJoints.clear();
+	}
+	// Objects new since the last keyframe join the tracks, holding their current pose in
+	// the keyframes that came before them
+	unordered_set<SceneObject*> tracked(tracks.begin(), tracks.end());
+	for (auto obj : *liveScene) {
+		if (tracked.count(obj)) continue;
+		tracks.push_back(obj);
+		SceneObjectInfo info;
+		info.position = obj->position;
+		info.rotation = obj->rotation;
+		for (auto &keyFrame : keyFrames) keyFrame.scene.push_back(info);
+	}
+	keyFrames.push_back(KeyFrame(tracks));
 	cout << "Added KeyFrame #" << keyFrames.size() << endl;
 }
 
+void Animation::removeObject(SceneObject* obj) {
+	auto found = find(tracks.begin(), tracks.end(), obj);
+	if (found == tracks.end()) return;
+	int track = found - tracks.begin();
+	tracks.erase(found);
+	for (auto &keyFrame : keyFrames) keyFrame.scene.erase(keyFrame.scene.begin() + track);
+}
+
 void ofApp::handleKeyFrameSave() {
 	if(animation == nullptr) animation = new Animation(&scene);
 	else animation->liveScene = &scene;
 	animation->addFrameFromScene();
 }
 
+// Replace the animation with a motion capture, played at the capture's own rate.
+// joints[i] is driven by the motion's joint i.
+void ofApp::playMotion(const vector<Joint*> &joints, SkeletonMotion &&motion) {
+	if (animation == nullptr) animation = new Animation(&scene);
+	else animation->liveScene = &scene;
+	int numFrames = motion.numFrames;
+	float seconds = motion.numFrames * motion.frameTime;
+	animation->setMotion(joints, move(motion));
+	animation->sampleMotion(); // Rests on the first frame until it's started
+	cout << " - motion: " << numFrames << " frames (" << seconds << " s)" << endl;
+}
+
+// Step the animation and every IK arm at a fixed rate with nothing drawn in between, and
+// stream each frame's joint channels to path (.bvh or .csv).  The scene's clocks follow
+// the export instead of the wall, so it runs as fast as the solvers allow.
+void ofApp::exportMotion(const string &path, float seconds, float fps) {
+	SkeletonDesc skeleton;
+	vector<Joint*> joints;
+	describeScene(skeleton, &joints);
+	if (joints.empty()) {
+		cout << "There's no skeleton to export." << endl;
+		return;
+	}
+	MotionWriter writer;
+	string error;
+	if (!writer.open(path, skeleton, 1 / fps, error)) {
+		cout << "Export failed: " << error << endl;
+		return;
+	}
+
+	float time = 0;
+	auto exportClock = [&time] { return time; };
+	IKArm::clock = exportClock;
+	bool animating = animation != nullptr && animation->isPlayable();
+	bool wasPlaying = animating && !animation->paused;
+	if (animating) {
+		animation->clock = exportClock;
+		animation->start();
+	}
+	for (auto obj : scene) { // Solve times so far are on the wall clock
+		if (IKArm* arm = dynamic_cast<IKArm*>(obj)) arm->restart();
+	}
+
+	int numFrames = (int)ceilf(seconds * fps);
+	vector<glm::vec3> rotations(joints.size()), translations(joints.size());
+	uint64_t start = ofGetElapsedTimeMicros();
+	for (int frame = 0; frame < numFrames; frame++) {
+		time = frame / fps;
+		framePipeline.run(AnimationStage, IKStage);
+		for (int j = 0; j < joints.size(); j++) {
+			rotations[j] = joints[j]->rotation;
+			translations[j] = joints[j]->position;
+		}
+		writer.writeFrame(rotations.data(), translations.data());
+	}
+	bool ok = writer.close(error);
+	float elapsed = (ofGetElapsedTimeMicros() - start) / 1.0e6f;
+
+	// back to the wall clock and the pose we started from
+	IKArm::clock = ofGetElapsedTimef;
+	if (animating) {
+		animation->clock = ofGetElapsedTimef;
+		if (wasPlaying) animation->start();
+		else animation->paused = true;
+	}
+	for (int j = 0; j < joints.size(); j++) {
+		joints[j]->rotation = skeleton.joints[j].rotation;
+		joints[j]->position = skeleton.joints[j].translation;
+	}
+	for (auto obj : scene) { // ... and these are on the export's
+		if (IKArm* arm = dynamic_cast<IKArm*>(obj)) arm->restart();
+	}
+
+	if (!ok) cout << "Export failed: " << error << endl;
+	else cout << "Exported " << numFrames << " frames (" << seconds << " s) to " << path << " in " << elapsed << " s" << endl;
+}
+
 void ofApp::handleStartAnimation() {
 	animation->start();
 }
@@ -21,8 +21,25 @@
 #include "glm/gtc/quaternion.hpp"
 
 #include <assert.h>
+#include <atomic>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
 #include "vector3.h"
 #include "ray.h"
+#include "transform.h"
+#include "jointAxis.h"
+#include "ikChain.h"
+#include "twoBoneIK.h"
+#include "reachability.h"
+#include "solutionCache.h"
+#include "multiStartIK.h"
+#include "ikTree.h"
+#include "skeletonIO.h"
+#include "bvhIO.h"
+#include "fileWatcher.h"
+#include "objectPool.h"
+#include "framePipeline.h"
 
 /*
  * Axis-aligned bounding box class, for use with the optimized ray-box
@@ -103,47 +120,46 @@ public:
 	}
 
 
-	glm::mat4 getLocalMatrix() {
-
-		// get the local transformations + pivot
-		//
-		glm::mat4 scale = getScaleMatrix();
-		glm::mat4 rotate = getRotateMatrix();
-		glm::mat4 trans = getTranslateMatrix();
-
-		// handle pivot point  (rotate around a point that is not the object's center)
-		//
-		glm::mat4 pre = glm::translate(glm::mat4(1.0), glm::vec3(-pivot.x, -pivot.y, -pivot.z));
-		glm::mat4 post = glm::translate(glm::mat4(1.0), glm::vec3(pivot.x, pivot.y, pivot.z));
-
-
-
-		return (trans * post * rotate * pre * scale);
+	glm::quat getRotation() {
+		return Transform::rotationFromEuler(rotation);   // yaw, pitch, roll
+	}
 
+	// local transformations + pivot (rotate around a point that is not the object's center)
+	//
+	Transform getLocalTransform() {
+		return Transform::fromTRS(position, getRotation(), scale, pivot);
 	}
 
-	glm::mat4 getMatrix() {
+	Transform getTransform() {
 
 		// if we have a parent (we are not the root),
 		// concatenate parent's transform (this is recursive)
 		// 
 		if (parent) {
-			glm::mat4 M = parent->getMatrix();
-			return (M * getLocalMatrix());
+			return (parent->getTransform() * getLocalTransform());
 		}
-		else return getLocalMatrix();  // priority order is SRT
+		else return getLocalTransform();  // priority order is SRT
+	}
+
+	// 4x4 versions, only needed at the draw boundary
+	//
+	glm::mat4 getLocalMatrix() {
+		return getLocalTransform().toMat4();
+	}
+	glm::mat4 getMatrix() {
+		return getTransform().toMat4();
 	}
 
 	// get current Position in World Space
 	//
 	glm::vec3 getPosition() {
-		return (getMatrix() * glm::vec4(0.0, 0.0, 0.0, 1.0));
+		return getTransform().translation;
 	}
 
 	// set position (pos is in world space)
 	//
 	void setPosition(glm::vec3 pos) {
-		position = glm::inverse(getMatrix()) * glm::vec4(pos, 1.0);
+		position = getTransform().inverse().transformPoint(pos);
 	}
 
 	// return a rotation  matrix that rotates one vector to another
@@ -156,10 +172,29 @@ public:
 		childList.push_back(child);
 		child->parent = this;
 	}
+	void removeChild(SceneObject *child) {
+		childList.erase(remove(childList.begin(), childList.end(), child), childList.end());
+		if (child->parent == this) child->parent = NULL;
+	}
 
 	SceneObject *parent = NULL;        // if parent = NULL, then this obj is the ROOT
 	vector<SceneObject *> childList;
 
+	//  Filled in once a frame by the frame pipeline (see ofApp::setupFramePipeline), for
+	//  the stages after it and for drawing.  Editing uses getTransform(), which is always current.
+	//
+	Transform world;
+	glm::vec3 boundsCenter = glm::vec3(0, 0, 0);  // world space bounding sphere
+	float boundsRadius = FLT_MAX;                 // FLT_MAX = unbounded, never culled
+
+	virtual float localRadius() { return FLT_MAX; } // bounding sphere about the origin, before scaling
+	virtual void refitBounds() {
+		float r = localRadius();
+		float maxScale = max(fabsf(world.scale.x), max(fabsf(world.scale.y), fabsf(world.scale.z)));
+		boundsCenter = world.translation;
+		boundsRadius = (r == FLT_MAX) ? FLT_MAX : max(r, 1.5f) * maxScale; // axes are drawn out to 1.5
+	}
+
 	// position/orientation 
 	//
 	glm::vec3 position = glm::vec3(0, 0, 0);   // translate
@@ -179,6 +214,8 @@ public:
 	//
 	bool isSelectable = true;
 	string name = "SceneObject";
+
+	int sceneIndex = -1; // Where it is in ofApp::scene, so it can be taken out without a search
 };
 
 class Cone : public SceneObject {
@@ -194,6 +231,7 @@ public:
 	}
 	void draw();
 	bool intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &normal);
+	float localRadius() { return sqrtf(radius * radius + height * height / 4); }
 
 	float radius = 1.0;
 	float height = 2.0;
@@ -212,6 +250,7 @@ public:
 	}
 	void draw();
 	bool intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &normal);
+	float localRadius() { return glm::length(glm::vec3(width, height, depth)) / 2; }
 
 	float width = 2.0;
 	float height = 2.0;
@@ -226,8 +265,10 @@ public:
 	Sphere() {}
 	bool intersect(const Ray &ray, glm::vec3 &point, glm::vec3 &normal);
 	void draw();
+	float localRadius() { return radius; }
 
 	float radius = 1.0;
+	static ObjectPool<Sphere> pool; // Spawned obstacles
 };
 
 
@@ -295,94 +336,92 @@ public:
 		startOffset = p;
 	}
 
+	// Restrict the joint to rotating about a single axis (used by IK)
+	//
+	void lockAxis(JointAxis axis) {
+		lockedAxis = axis;
+		axisIsLocked = true;
+	}
+	float &lockedAngle() { return rotation[(int)lockedAxis]; }
+
+	// Per-axis angle limits (degrees) that the IK solvers keep the joint within
+	//
+	void setLimits(glm::vec3 minAngles_, glm::vec3 maxAngles_) {
+		minAngles = minAngles_;
+		maxAngles = maxAngles_;
+		hasLimits = true;
+	}
+	float minAngle(JointAxis axis) const { return hasLimits ? minAngles[(int)axis] : -FLT_MAX; }
+	float maxAngle(JointAxis axis) const { return hasLimits ? maxAngles[(int)axis] : FLT_MAX; }
+
 	float defaultRadius = 0.5;
 	bool axisIsLocked;
-	glm::vec3 lockedAxis;
+	JointAxis lockedAxis = JointAxis::Y;
 	glm::vec3 startOffset;
+	bool hasLimits = false;
+	glm::vec3 minAngles = glm::vec3(-180, -180, -180);
+	glm::vec3 maxAngles = glm::vec3(180, 180, 180);
 
 	void draw();
+	void refitBounds(); // Takes in the bone to the parent as well
+
+	static ObjectPool<Joint> pool; // Every joint the app spawns
+	typedef ObjectPool<Joint>::Handle Handle;
+	// True while every handle still refers to a live joint (null handles, for joints from
+	// outside the pool, can't be checked and count as live)
+	static bool allAlive(const vector<Handle> &handles) {
+		for (auto &handle : handles) {
+			if (!handle.isNull() && pool.get(handle) == NULL) return false;
+		}
+		return true;
+	}
 };
 
 // IK Stuff
 // Uses gradient descent to animate an inverse kinematics arm
 class IKArm : public SceneObject {
-private:
-	glm::vec3 normX = { 1, 0, 0 };
-	glm::vec3 normY = { 0, 1, 0 };
-	glm::vec3 normZ = { 0, 0, 1 };
-
 public:
 	IKArm(vector<Joint*> joints_, Joint* target_) {
 		joints = joints_;
 		for (int i = 0; i < joints.size(); i++) {
-			auto joint = joints[i];
-			if (i == 0) { // Base joint
-				joint->lockedAxis = normY;
-				//angles.push_back(joint->rotation.y);
-			}
-			else {
-				joint->lockedAxis = normZ;
-				//angles.push_back(joint->rotation.z);
-			}
-			joint->axisIsLocked = true;
+			if (i == 0) joints[i]->lockAxis(JointAxis::Y); // Base joint
+			else joints[i]->lockAxis(JointAxis::Z);
 		}
 		target = target_;
+		for (auto joint : joints) handles.push_back(Joint::pool.handleOf(joint));
+		handles.push_back(Joint::pool.handleOf(target));
 		isSelectable = false;
+		chain = makeIKChain(joints.size());
+		scratchAngles.resize(joints.size());
+		gatherChain();
+		getAngles(solvedAngles);
+		previousAngles = solvedAngles;
 	}
-	void setAngles(vector<float> angles) {
+	void setAngles(const vector<float> &angles) {
 		for (int i = 0; i < joints.size(); i++) {
-			auto joint = joints[i];
-			auto angle = angles[i];
-			if (joint->lockedAxis == normX) {
-				joint->rotation.x = angle;
-			}
-			else if (joint->lockedAxis == normY) {
-				joint->rotation.y = angle;
-			}
-			else if (joint->lockedAxis == normZ) {
-				joint->rotation.z = angle;
-			}
+			joints[i]->lockedAngle() = angles[i];
 		}
 	}
-	void applyAngles() {
-		vector<float> angles = getAngles();
+	void getAngles(vector<float> &angles) { // Fills caller's buffer, reusing its capacity
+		angles.resize(joints.size());
 		for (int i = 0; i < joints.size(); i++) {
-			auto joint = joints[i];
-			auto angle = angles[i];
-			if (joint->lockedAxis == normX) {
-				joint->rotation.x = angle;
-			}
-			else if (joint->lockedAxis == normY) {
-				joint->rotation.y = angle;
-			}
-			else if (joint->lockedAxis == normZ) {
-				joint->rotation.z = angle;
-			}
+			angles[i] = joints[i]->lockedAngle();
 		}
 	}
-	vector<float> getAngles() {
-		vector<float> angles;
-		for (int i = 0; i < joints.size(); i++) {
-			auto joint = joints[i];
-			if (joint->lockedAxis == normX) {
-				angles.push_back(joint->rotation.x);
-			}
-			else if (joint->lockedAxis == normY) {
-				angles.push_back(joint->rotation.y);
-			}
-			else if (joint->lockedAxis == normZ) {
-				angles.push_back(joint->rotation.z);
-			}
-		}
-		return angles;
-	}
-	glm::vec3 simulateRotations(vector<float> jointAngles); 
-	float distanceToTarget(vector<float> jointAngles); 
-	float gradient(vector<float> jointAngles, int jointIndex); 
+	Transform getBaseTransform(); // Frame the base joint hangs off (its parent, if any)
+	bool gatherChain(); // Copy joint transforms and angles into the solver - true if the bones changed
+	void scatterChain(); // Copy solved angles back onto the joints
+	void warmStart(const glm::vec3 &localTarget, const Transform &base, const glm::vec3 &targetPos, float currentDist);
 	void moveTowardsTarget(); 
-	void update() {
-		moveTowardsTarget();
-	}
+	void park(const Transform &base, const glm::vec3 &targetPos); // Nothing to do until the inputs change
+	bool inputsChanged(); // Target, base or any chain joint moved since we parked
+	void update();
+	bool jointsAlive() const { return Joint::allAlive(handles); } // False once a joint or the target is deleted; the arm stops
+	float getSolveRate() { return (solveRate >= 0) ? solveRate : defaultSolveRate.get(); }
+	static function<float()> clock; // Seconds, for solve rates and blending; offline export swaps in its own
+	void recordSolution(float time); // Remember the pose the solver just left the joints in
+	void showBlendedPose(float time); // Pose between solves, from the last two solutions
+	void restart(); // Drop the solve in progress and the solve times, e.g. when the clock is swapped
 	void draw() {
 		/*for (auto joint : joints) {
 			ofSetColor(diffuseColor);
@@ -391,14 +430,97 @@ public:
 	}
 
 	vector<Joint*> joints;
+	vector<Joint::Handle> handles; // joints then target, to tell when they've been deleted
+	unique_ptr<IKChainSolver> chain; // Fixed-length solver for common chain lengths, runtime-sized otherwise
 
 	Joint* target;
-	static ofParameter<float> learningRate; // Rate of change of the gradient after calculation
-	static ofParameter<float> deltaRotation; // Size of each rotation jump during gradient descent
+	Joint::Handle pole; // Two-bone chains bend their elbow towards this (null, or deleted: where the elbow is now)
+	Joint* getPole() const { return Joint::pool.get(pole); }
+	void setPole(Joint* pole_) { pole = Joint::pool.handleOf(pole_); parked = false; }
+	bool targetReachable = true; // Exact for two-bone chains, conservative (envelope/map) for iterative ones
+	ReachEnvelope envelope; // Recomputed whenever the bones change
+	ReachabilityMap reachMap; // Built lazily when useReachabilityMap is on
+	IKSolutionCache solutionCache; // Converged poses by target position, to warm-start new solves
+	vector<float> scratchAngles; // Sized once with the chain
+	bool solving = false; // Between a target move and convergence
+	bool parked = false; // Converged (or given up) - skipped until inputsChanged()
+	glm::vec3 parkedTarget; // Inputs when we parked
+	glm::vec3 parkedPole;
+	Transform parkedBase;
+	int solveIterations = 0; // Gradient steps spent on the current solve
+	int lastSolveIterations = 0; // ... and on the last one that converged
+	MultiStartIK multiStart; // Seed chains for restarting a stalled solve
+	const SignedDistanceField* obstacles = NULL; // Scene obstacles to keep the bones out of
+	int parkedObstacleVersion = 0;
+	float solveRate = -1; // Solves per second for this arm: 0 = every frame, < 0 = defaultSolveRate
+	vector<float> solvedAngles; // Last solution ...
+	vector<float> previousAngles; // ... and the one before, to blend between
+	float solveTime = 0; // When they were solved
+	float previousSolveTime = 0;
+	bool showingBlend = false; // Joints hold a blended pose rather than solvedAngles
+	int framesSinceUpdate = 0; // Staleness: frames this arm has waited on the IKScheduler
+	int maxFramesSinceUpdate = 0; // ... and the longest it has ever waited
+	float stallBestDist = 0; // Closest the current solve has got ...
+	int stallSteps = 0; // ... and how many steps since that improved
+	static ofParameter<int> optimizer; // IKOptimizer: 0 fixed learning rate, 1 momentum, 2 Adam
+	static ofParameter<float> learningRate; // Rate of change of the gradient after calculation (fixed only)
+	static ofParameter<float> deltaRotation; // Size of each rotation jump during gradient descent (fixed only)
 	static ofParameter<float> distThreshold; // Maximum acceptable distance - if within, don't move closer
+	static ofParameter<bool> useReachabilityMap; // Voxelized reach test for targets inside the envelope
+	static ofParameter<bool> useSolutionCache; // Start new solves from the nearest cached solution
+	static ofParameter<bool> avoidObstacles; // Penalize bones that come within obstacleMargin of an obstacle
+	static ofParameter<float> obstacleMargin;
+	static ofParameter<bool> useMultiStart; // Restart stalled solves from several seed poses in parallel
+	static ofParameter<int> multiStartSeeds; // How many seed poses
+	static ofParameter<int> parallelMinJoints; // Chains at least this long spread their gradient over the thread pool
+	static atomic<int> numActive; // Arms that did IK work this frame
+	static atomic<int> numParked; // Arms that were skipped this frame
+	static atomic<int> numBlended; // Arms between solves this frame (showing a blended pose)
+	static ofParameter<float> defaultSolveRate; // Solves per second for arms that don't set their own (0 = every frame)
+	static ofParameter<bool> extrapolatePoses; // Between solves, run ahead of the last solution instead of easing into it
+	static ObjectPool<IKArm> pool;
+};
+
+// Solves every limb of a branching skeleton together, one target per leaf joint
+class IKTreeRig : public SceneObject {
+public:
+	IKTreeRig(Joint* root); // Every joint under root becomes part of the tree
+	void addEffector(Joint* joint, Joint* target, float weight = 1);
+	void gatherTree(); // Copy joint transforms and target positions into the solver
+	void scatterTree(); // Copy solved rotations back onto the joints
+	void update();
+	void draw() { }
+
+	vector<Joint*> joints; // Parents before children, same order as the tree's nodes
+	vector<Joint*> targets; // One per effector
+	vector<Joint::Handle> handles; // joints and targets, to stop when any of them is deleted
+	IKTree tree;
+	static ofParameter<float> damping; // Bigger = steadier but slower near unreachable targets
+	static ObjectPool<IKTreeRig> pool;
 };
 
 
+// Decides which IK arms get to update each frame when there are too many to update them all.
+// Arms are served highest priority first - how far off target they are x how much it
+// matters (close to the camera, selected) x how long they've been waiting - until the
+// frame's time budget runs out.  The waiting factor means every arm gets its turn.
+class IKScheduler {
+public:
+	void run(const vector<IKArm*> &arms, glm::vec3 cameraPos, const vector<SceneObject*> &selected);
+	float importance(IKArm* arm, glm::vec3 cameraPos, const vector<SceneObject*> &selected);
+
+	int numScheduled = 0; // Arms updated last frame
+	int numWaiting = 0; // Arms that ran out of budget last frame
+	float meanStaleness = 0; // Frames arms have been waiting, averaged over all arms
+	int maxStaleness = 0; // Longest any arm has been waiting
+
+	static ofParameter<bool> enabled;
+	static ofParameter<float> budgetMs; // IK time per frame, across all arms
+
+private:
+	priority_queue<pair<float, int>> ready; // (priority, index into arms); drained every run
+};
+
 // Keyframing stuff
 typedef struct {
 	glm::vec3 position;
@@ -407,8 +529,8 @@ typedef struct {
 
 class KeyFrame {
 public:
-	KeyFrame(vector<SceneObject*> scene_) {
-		for (auto obj : scene_) {
+	KeyFrame(const vector<SceneObject*> &objects) {
+		for (auto obj : objects) {
 			SceneObjectInfo info;
 			info.position = obj->position;
 			info.rotation = obj->rotation;
@@ -416,7 +538,7 @@ public:
 		}
 	}
 
-	vector<SceneObjectInfo> scene;
+	vector<SceneObjectInfo> scene; // One per Animation::tracks entry, in the same order
 };
 
 class Animation {
@@ -438,13 +560,23 @@ public:
 	}
 
 	float getTimeSinceLastKeyFrame() {
-		return ofGetElapsedTimef() - timeAtLastKeyFrame;
+		return clock() - timeAtLastKeyFrame;
 	}
 
 	void addFrameFromScene();
 	void applyStartKeyFrame();
+	void removeObject(SceneObject* obj); // Stop animating obj (it's being deleted)
+
+	// A motion capture plays instead of the keyframes.  It's sampled by elapsed time, so it
+	// keeps its own rate whatever the app's frame rate, and only touches the joints it drives.
+	void setMotion(const vector<Joint*> &joints, SkeletonMotion &&motion_);
+	void sampleMotion();
+	bool isPlayable() { return motion.numFrames > 0 || keyFrames.size() >= 2; }
+	SkeletonMotion motion;
+	vector<Joint::Handle> motionJoints; // Motion joint i drives motionJoints[i], while it's alive
 
 	vector<KeyFrame> keyFrames;
+	vector<SceneObject*> tracks; // The objects the keyframes drive, so they follow objects rather than scene slots
 	int currentFrameIdx;
 	int nextFrameIdx;
 	bool paused;
@@ -452,9 +584,25 @@ public:
 	float timeAtLastKeyFrame;
 
 	vector<SceneObject*>* liveScene;
+	function<float()> clock = ofGetElapsedTimef; // Seconds; swapped out to play back faster than real time
 	static ofParameter<float> lengthInSeconds; // How long the animation takes 
 };
 
+// What the stages of a frame read and write, for the FramePipeline to order them by
+namespace FrameResource {
+	enum : unsigned {
+		Files = 1 << 0,           // Saving, loading and watching skeleton files
+		SceneGraph = 1 << 1,      // Which objects there are and who their parents are
+		LocalPose = 1 << 2,       // Each object's position, rotation and scale
+		Obstacles = 1 << 3,       // The distance field the IK arms keep out of
+		WorldTransforms = 1 << 4, // SceneObject::world
+		Bounds = 1 << 5,          // SceneObject::boundsCenter/boundsRadius
+		Camera = 1 << 6,
+		DrawList = 1 << 7,
+		All = ~0u
+	};
+}
+
 class ofApp : public ofBaseApp{
 
 	public:
@@ -509,24 +657,80 @@ class ofApp : public ofBaseApp{
 		bool bRotateZ = false;
 		glm::vec3 lastPoint;
 		void clearScene();
+		void addToScene(SceneObject* obj);
+		void removeFromScene(SceneObject* obj); // Swaps the last object into its place
+		bool isInScene(SceneObject* obj) { return obj->sceneIndex >= 0 && obj->sceneIndex < (int)scene.size() && scene[obj->sceneIndex] == obj; }
 
 		// Skeleton
 		void spawnJoint();
-		void spawnJoint(string name, glm::vec3 rot, glm::vec3 trans, Joint* parent);
+		Joint* spawnJoint(string name, glm::vec3 rot, glm::vec3 trans, Joint* parent);
 		int numJointsSpawned = 0;
 		void deleteSelected();
+		void releaseObject(SceneObject* obj);
 		void saveToFile();
-		void loadFromFile(string filename);
+		SkeletonWriter skeletonWriter;
+		void loadFromFiles(const vector<string> &filenames);
+		void finishLoading();
+		SkeletonLoader skeletonLoader;
+		bool loadingIsReload = false; // The batch in skeletonLoader came from the file watcher
+
+		// Hot reload: loaded files are watched, and when one is written its joints are
+		// updated in place (matched by name) instead of rebuilding the scene
+		ofParameter<bool> hotReload{ "Hot reload files", false };
+		FileWatcher fileWatcher;
+		map<string, vector<Joint::Handle>> loadedFiles; // Path -> the joints it made, in file order
+		vector<string> pendingReloads; // Loaded files written since the last reload started, once each
+		vector<string> changedFiles; // Reused each frame for the watcher's events
+		void checkForReloads();
+		void applySkeletonDiff(const string &path, const SkeletonDesc &skeleton);
+		vector<Joint*> buildSkeleton(const SkeletonDesc &skeleton);
+		vector<Joint*> buildSkeleton(const SkeletonBinaryView &skeleton);
+		void describeScene(SkeletonDesc &skeleton, vector<Joint*> *joints = NULL);
+
+		// Offline export of the animation and IK, stepped at a fixed rate
+		ofParameter<float> exportSeconds{ "Export length (s)", 10, 1, 600 };
+		ofParameter<int> exportRate{ "Export rate (fps)", 30, 1, 240 };
+		void exportMotion(const string &path, float seconds, float fps);
+
+		// The frame's update, as stages that say what they read and write (see framePipeline.h)
+		FramePipeline framePipeline;
+		enum { InputStage, AnimationStage, ObstacleStage, IKStage, TransformStage, BoundsStage, DrawListStage };
+		void setupFramePipeline();
+		void propagateTransforms(); // World transforms, a root's tree per job
+		void buildDrawList(); // The scene less whatever is outside the camera's view
+		vector<SceneObject*> sceneRoots; // Reused each frame
+		vector<SceneObject*> drawList; // What draw() draws
+		vector<char> visible;
+		ofParameter<bool> showFrameStats{ "Frame stage times", false };
 		SceneObject* findObjFromName(string name);
 
+		// Obstacles (every non-joint Cube, Sphere, Cone and Plane) for the IK arms to avoid
+		SignedDistanceField obstacleField;
+		vector<pair<SceneObject*, int>> obstacleIds; // Shape id for each obstacle, sorted by object
+		vector<pair<SceneObject*, int>> obstacleIdsNext; // Reused each frame, then swapped in
+		void updateObstacles(); // Sync the field with the scene, re-baking only what moved
+		void spawnObstacle();
+
 		// IK
 		void startIK();
+		void startTreeIK();
+		void runIKBenchmark();
+		IKScheduler ikScheduler;
+		vector<IKArm*> ikArms; // Reused each frame to hand the arms to the scheduler
+		void updateIK(); // Every IK solver, an island per job
+		void buildIKIslands();
+		vector<SceneObject*> ikSolvers; // Live arms and tree rigs, in scene order
+		vector<pair<int, int>> ikOrder; // (island's first solver, solver), sorted - so grouped by island
+		vector<int> ikIslandStart; // Where each island starts in ikOrder, and where the last one ends
+		vector<int> ikUnion, ikIslandFirst; // Scratch for buildIKIslands
+		unordered_map<SceneObject*, int> ikRootOwner;
 
 
 		// Animation
 		Animation* animation = nullptr;
 		float animationLength = 3; // Seconds
 		void handleKeyFrameSave();
+		void playMotion(const vector<Joint*> &joints, SkeletonMotion &&motion);
 		void handleStartAnimation();
 		void handleToggleAnimationPause();
 
@@ -0,0 +1,162 @@
+#ifndef _REACHABILITY_H_
+#define _REACHABILITY_H_
+
+#include <math.h>
+#include <vector>
+#include <random>
+#include "ikChain.h"
+
+/*
+ * Cheap "can this chain possibly get there" tests, all in the frame the base joint
+ * hangs off (so moving the whole rig doesn't invalidate anything).
+ *
+ * ReachEnvelope is the shell between the closest and furthest the end joint can be
+ * from the base joint, worked out from bone lengths alone - an O(1) test per target.
+ * ReachabilityMap is an optional voxel grid of where sampled poses actually put
+ * the end joint, which also catches the holes a locked-axis chain can't reach.
+ */
+
+enum class Reach { Inside, TooFar, TooClose };
+
+struct ReachEnvelope {
+	glm::vec3 center = glm::vec3(0, 0, 0);  // base joint's pivot, which no chain angle moves
+	float maxReach = 0;
+	float minReach = 0;
+
+	static ReachEnvelope compute(const IKChainSolver &chain) {
+		ReachEnvelope env;
+		const ChainLink &first = chain.getLink(0);
+		env.center = first.position + first.pivot;
+
+		// furthest the end can get from each joint, from the end inwards
+		bool hasPivots = false;
+		float longest = 0, total = 0;
+		float reach = 0;
+		for (int i = chain.size() - 1; i >= 1; i--) {
+			const ChainLink &link = chain.getLink(i);
+			float s = fmaxf(fabsf(link.scale.x), fmaxf(fabsf(link.scale.y), fabsf(link.scale.z)));
+			float bone = glm::length(link.position + link.pivot) + glm::length(link.pivot);
+			reach = bone + s * reach;
+			if (link.pivot != glm::vec3(0, 0, 0) || link.scale != glm::vec3(1, 1, 1)) hasPivots = true;
+			longest = fmaxf(longest, bone);
+			total += bone;
+		}
+		float s0 = fmaxf(fabsf(first.scale.x), fmaxf(fabsf(first.scale.y), fabsf(first.scale.z)));
+		env.maxReach = s0 * reach + glm::length(first.pivot);
+
+		// a bone longer than all the others together can't fold back to the base joint
+		if (!hasPivots && first.pivot == glm::vec3(0, 0, 0) && first.scale == glm::vec3(1, 1, 1)) {
+			env.minReach = fmaxf(0, longest - (total - longest));
+		}
+		return env;
+	}
+
+	Reach classify(const glm::vec3 &localTarget) const {
+		float dist = glm::distance(localTarget, center);
+		if (dist > maxReach) return Reach::TooFar;
+		if (dist < minReach) return Reach::TooClose;
+		return Reach::Inside;
+	}
+};
+
+// Point a yaw + hinges chain (Y, Z, Z, ..., end) straight at the target: yaw the hinge
+// plane onto it, then line every bone up with the direction from the first hinge.
+// Joints stop at their limits.  Returns false (chain untouched) for other chain shapes.
+//
+inline bool stretchTowards(IKChainSolver &chain, const glm::vec3 &localTarget) {
+	int n = chain.size();
+	if (n < 3 || chain.getLink(0).axis != JointAxis::Y) return false;
+	for (int i = 0; i < n; i++) {
+		const ChainLink &link = chain.getLink(i);
+		if (i > 0 && i < n - 1 && link.axis != JointAxis::Z) return false;
+		if (link.scale != glm::vec3(1, 1, 1) || link.pivot != glm::vec3(0, 0, 0)) return false;
+	}
+
+	glm::vec3 d = localTarget - chain.getLink(0).position;
+	float zc = 0;
+	for (int i = 1; i < n; i++) zc += chain.getLink(i).position.z;
+	float r = sqrtf(d.x * d.x + d.z * d.z);
+	float yawOffset = (r > 1e-5f) ? acosf(glm::clamp(zc / r, -1.0f, 1.0f)) : 0;
+	float yaw = atan2f(d.x, d.z) + yawOffset;
+	float planarX = -sqrtf(fmaxf(r * r - zc * zc, 0));
+
+	// direction to the target in the hinge plane, from the first hinge
+	glm::vec3 t1 = chain.getLink(1).position;
+	float theta = atan2f(d.y - t1.y, planarX - t1.x);
+
+	float yawDeg = glm::degrees(yaw);
+	chain.setAngle(0, chain.getLink(0).clampAngle(chain.getAngle(0) + remainderf(yawDeg - chain.getAngle(0), 360.0f)));
+	for (int i = 1; i < n - 1; i++) {
+		glm::vec3 bone = chain.getLink(i + 1).position;
+		float boneAngle = atan2f(bone.y, bone.x);
+		float target;
+		if (i == 1) target = theta - boneAngle;
+		else {
+			glm::vec3 prevBone = chain.getLink(i).position;
+			target = atan2f(prevBone.y, prevBone.x) - boneAngle;
+		}
+		float deg = glm::degrees(target);
+		chain.setAngle(i, chain.getLink(i).clampAngle(chain.getAngle(i) + remainderf(deg - chain.getAngle(i), 360.0f)));
+	}
+	return true;
+}
+
+class ReachabilityMap {
+public:
+	bool isBuilt() const { return !cells.empty(); }
+	void clear() { cells.clear(); }
+
+	// Sample random poses (within the joint limits) and mark every voxel the end joint lands in, then grow the
+	// marked region by one voxel so sampling gaps don't turn into false "unreachable"s
+	//
+	void build(const IKChainSolver &chain, const ReachEnvelope &env, int resolution = 24, int samples = 20000) {
+		res = resolution;
+		cellSize = fmaxf(2 * env.maxReach / res, 1e-4f);
+		origin = env.center - glm::vec3(env.maxReach, env.maxReach, env.maxReach);
+		std::vector<unsigned char> hit(res * res * res, 0);
+
+		std::mt19937 rng(12345);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		for (int s = 0; s < samples; s++) {
+			Transform sim;
+			for (int i = 0; i < chain.size(); i++) {
+				const ChainLink &link = chain.getLink(i);
+				float lo = fmaxf(link.minAngle, -180.0f), hi = fminf(link.maxAngle, 180.0f);
+				float a = lo + (hi - lo) * unit(rng);
+				composeAxisRotation(link.axis, sim, link.position, a, link.scale, link.pivot);
+			}
+			int index = cellIndex(sim.translation);
+			if (index >= 0) hit[index] = 1;
+		}
+
+		cells.assign(res * res * res, 0);
+		for (int z = 0; z < res; z++) for (int y = 0; y < res; y++) for (int x = 0; x < res; x++) {
+			if (!hit[(z * res + y) * res + x]) continue;
+			for (int dz = -1; dz <= 1; dz++) for (int dy = -1; dy <= 1; dy++) for (int dx = -1; dx <= 1; dx++) {
+				int nx = x + dx, ny = y + dy, nz = z + dz;
+				if (nx < 0 || ny < 0 || nz < 0 || nx >= res || ny >= res || nz >= res) continue;
+				cells[(nz * res + ny) * res + nx] = 1;
+			}
+		}
+	}
+
+	bool mayReach(const glm::vec3 &localTarget) const {
+		int index = cellIndex(localTarget);
+		return index >= 0 && cells[index];
+	}
+
+private:
+	int cellIndex(const glm::vec3 &p) const {
+		glm::vec3 c = (p - origin) / cellSize;
+		int x = (int)floorf(c.x), y = (int)floorf(c.y), z = (int)floorf(c.z);
+		if (x < 0 || y < 0 || z < 0 || x >= res || y >= res || z >= res) return -1;
+		return (z * res + y) * res + x;
+	}
+
+	glm::vec3 origin = glm::vec3(0, 0, 0);
+	float cellSize = 1;
+	int res = 0;
+	std::vector<unsigned char> cells;
+};
+
+#endif
@@ -0,0 +1,239 @@
+#ifndef _SIGNEDDISTANCEFIELD_H_
+#define _SIGNEDDISTANCEFIELD_H_
+
+#include <math.h>
+#include <float.h>
+#include <vector>
+#include "transform.h"
+
+/*
+ * Truncated signed distance field of the scene's obstacles, baked into a voxel grid
+ * so the IK solver can ask "how far is this point from anything solid" with eight
+ * reads and a trilinear blend instead of testing every primitive.
+ *
+ * Distances are clamped to +-truncation: a voxel further than that from every shape
+ * just stores the clamp.  That bounds what any one shape can affect, so moving,
+ * adding or removing a shape only re-bakes the voxels inside its old and new bounds
+ * (grown by the truncation) rather than the whole grid.
+ */
+
+struct SDFShape {
+	enum Type { Box, Sphere, Cylinder, HalfSpace };
+
+	Type type = Box;
+	Transform transform;                    // object to world
+	glm::vec3 size = glm::vec3(1, 1, 1);    // Box: half extents; Sphere: x = radius; Cylinder: x = radius, y = height
+
+	bool operator==(const SDFShape &o) const { return type == o.type && transform == o.transform && size == o.size; }
+	bool operator!=(const SDFShape &o) const { return !(*this == o); }
+
+	// World space distance (negative inside).  Scale is assumed close to uniform - the
+	// smallest axis is used, which errs on the side of "closer than it looks".
+	//
+	float distance(const glm::vec3 &worldPoint) const {
+		return localDistance(transform.inverse().transformPoint(worldPoint));
+	}
+
+	// Same, for a point already in object space
+	//
+	float localDistance(const glm::vec3 &p) const {
+		float s = fminf(fabsf(transform.scale.x), fminf(fabsf(transform.scale.y), fabsf(transform.scale.z)));
+		switch (type) {
+		case Box: {
+			glm::vec3 q = glm::abs(p) - size;
+			float outside = glm::length(glm::max(q, glm::vec3(0, 0, 0)));
+			return (outside + fminf(fmaxf(q.x, fmaxf(q.y, q.z)), 0.0f)) * s;
+		}
+		case Sphere:
+			return (glm::length(p) - size.x) * s;
+		case Cylinder: { // along y, centered on the origin
+			glm::vec2 q(glm::length(glm::vec2(p.x, p.z)) - size.x, fabsf(p.y) - size.y / 2);
+			float outside = glm::length(glm::max(q, glm::vec2(0, 0)));
+			return (outside + fminf(fmaxf(q.x, q.y), 0.0f)) * s;
+		}
+		default:         // everything below the object's xz plane is solid
+			return p.y * s;
+		}
+	}
+
+	// World space bounds of the solid part; a half-space has none
+	//
+	bool bounds(glm::vec3 &lo, glm::vec3 &hi) const {
+		glm::vec3 extent;
+		switch (type) {
+		case Box: extent = size; break;
+		case Sphere: extent = glm::vec3(size.x, size.x, size.x); break;
+		case Cylinder: extent = glm::vec3(size.x, size.y / 2, size.x); break;
+		default: return false;
+		}
+		lo = glm::vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+		hi = -lo;
+		for (int corner = 0; corner < 8; corner++) {
+			glm::vec3 c((corner & 1) ? extent.x : -extent.x, (corner & 2) ? extent.y : -extent.y, (corner & 4) ? extent.z : -extent.z);
+			glm::vec3 w = transform.transformPoint(c);
+			lo = glm::min(lo, w);
+			hi = glm::max(hi, w);
+		}
+		return true;
+	}
+};
+
+class SignedDistanceField {
+public:
+	// Grid covering [lo, hi] in cells of cellSize; drops all shapes
+	//
+	void setup(const glm::vec3 &lo, const glm::vec3 &hi, float cellSize_, float truncation_) {
+		origin = lo;
+		cellSize = cellSize_;
+		truncation = truncation_;
+		glm::vec3 extent = (hi - lo) / cellSize;
+		res[0] = (int)ceilf(extent.x) + 1;
+		res[1] = (int)ceilf(extent.y) + 1;
+		res[2] = (int)ceilf(extent.z) + 1;
+		values.assign(res[0] * res[1] * res[2], truncation);
+		shapes.clear();
+		alive.clear();
+		dirtyAll = false;
+		dirtyBoxes.clear();
+	}
+
+	bool isSetup() const { return !values.empty(); }
+	bool isEmpty() const {
+		for (bool a : alive) if (a) return false;
+		return true;
+	}
+
+	int addShape(const SDFShape &shape) {
+		shapes.push_back(shape);
+		alive.push_back(true);
+		markDirty(shape);
+		return (int)shapes.size() - 1;
+	}
+	void updateShape(int id, const SDFShape &shape) {
+		if (shapes[id] == shape) return;
+		markDirty(shapes[id]);
+		shapes[id] = shape;
+		markDirty(shape);
+	}
+	void removeShape(int id) {
+		if (!alive[id]) return;
+		markDirty(shapes[id]);
+		alive[id] = false;
+	}
+
+	bool needsRebuild() const { return dirtyAll || !dirtyBoxes.empty(); }
+
+	// Re-bake the voxels touched since the last rebuild.  Returns how many were baked.
+	//
+	int rebuild() {
+		int baked = 0;
+		if (dirtyAll) {
+			baked = bake(0, 0, 0, res[0] - 1, res[1] - 1, res[2] - 1);
+		}
+		else {
+			for (const DirtyBox &box : dirtyBoxes) {
+				baked += bake(box.lo[0], box.lo[1], box.lo[2], box.hi[0], box.hi[1], box.hi[2]);
+			}
+		}
+		dirtyAll = false;
+		dirtyBoxes.clear();
+		version++;
+		return baked;
+	}
+
+	// Trilinear distance at p, and its gradient if asked for.  Outside the grid
+	// everything is "far away".
+	//
+	float sample(const glm::vec3 &p, glm::vec3 *gradient = NULL) const {
+		glm::vec3 c = (p - origin) / cellSize;
+		int x = (int)floorf(c.x), y = (int)floorf(c.y), z = (int)floorf(c.z);
+		if (x < 0 || y < 0 || z < 0 || x >= res[0] - 1 || y >= res[1] - 1 || z >= res[2] - 1) {
+			if (gradient != NULL) *gradient = glm::vec3(0, 0, 0);
+			return truncation;
+		}
+		float fx = c.x - x, fy = c.y - y, fz = c.z - z;
+		int i = index(x, y, z);
+		int dy = res[0], dz = res[0] * res[1];
+		float v000 = values[i], v100 = values[i + 1];
+		float v010 = values[i + dy], v110 = values[i + dy + 1];
+		float v001 = values[i + dz], v101 = values[i + dz + 1];
+		float v011 = values[i + dy + dz], v111 = values[i + dy + dz + 1];
+
+		float x00 = v000 + (v100 - v000) * fx, x10 = v010 + (v110 - v010) * fx;
+		float x01 = v001 + (v101 - v001) * fx, x11 = v011 + (v111 - v011) * fx;
+		float y0 = x00 + (x10 - x00) * fy, y1 = x01 + (x11 - x01) * fy;
+		if (gradient != NULL) {
+			float gx0 = (v100 - v000) + ((v110 - v010) - (v100 - v000)) * fy;
+			float gx1 = (v101 - v001) + ((v111 - v011) - (v101 - v001)) * fy;
+			gradient->x = (gx0 + (gx1 - gx0) * fz) / cellSize;
+			gradient->y = ((x10 - x00) + ((x11 - x01) - (x10 - x00)) * fz) / cellSize;
+			gradient->z = (y1 - y0) / cellSize;
+		}
+		return y0 + (y1 - y0) * fz;
+	}
+
+	float getTruncation() const { return truncation; }
+	int getVersion() const { return version; } // Bumped by every rebuild
+
+private:
+	struct DirtyBox {
+		int lo[3], hi[3];
+	};
+
+	int index(int x, int y, int z) const { return (z * res[1] + y) * res[0] + x; }
+
+	void markDirty(const SDFShape &shape) {
+		glm::vec3 lo, hi;
+		if (!shape.bounds(lo, hi)) {
+			dirtyAll = true;
+			return;
+		}
+		glm::vec3 pad(truncation + cellSize, truncation + cellSize, truncation + cellSize);
+		glm::vec3 a = (lo - pad - origin) / cellSize, b = (hi + pad - origin) / cellSize;
+		DirtyBox box;
+		for (int k = 0; k < 3; k++) {
+			box.lo[k] = glm::clamp((int)floorf(a[k]), 0, res[k] - 1);
+			box.hi[k] = glm::clamp((int)ceilf(b[k]), 0, res[k] - 1);
+			if (b[k] < 0 || a[k] > res[k] - 1) return; // entirely off the grid
+		}
+		dirtyBoxes.push_back(box);
+	}
+
+	int bake(int x0, int y0, int z0, int x1, int y1, int z1) {
+		for (int z = z0; z <= z1; z++) for (int y = y0; y <= y1; y++) for (int x = x0; x <= x1; x++) {
+			values[index(x, y, z)] = truncation;
+		}
+		for (int s = 0; s < (int)shapes.size(); s++) {
+			if (!alive[s]) continue;
+			const SDFShape &shape = shapes[s];
+			glm::vec3 lo, hi;
+			if (shape.bounds(lo, hi)) { // too far from this region to get under the truncation
+				glm::vec3 a = (lo - origin - truncation) / cellSize, b = (hi - origin + truncation) / cellSize;
+				if (a.x > x1 || a.y > y1 || a.z > z1 || b.x < x0 || b.y < y0 || b.z < z0) continue;
+			}
+			Transform toLocal = shape.transform.inverse();
+			for (int z = z0; z <= z1; z++) for (int y = y0; y <= y1; y++) for (int x = x0; x <= x1; x++) {
+				float &value = values[index(x, y, z)];
+				value = fminf(value, shape.localDistance(toLocal.transformPoint(origin + glm::vec3(x, y, z) * cellSize)));
+			}
+		}
+		for (int z = z0; z <= z1; z++) for (int y = y0; y <= y1; y++) for (int x = x0; x <= x1; x++) {
+			float &value = values[index(x, y, z)];
+			value = fmaxf(value, -truncation);
+		}
+		return (x1 - x0 + 1) * (y1 - y0 + 1) * (z1 - z0 + 1);
+	}
+
+	glm::vec3 origin = glm::vec3(0, 0, 0);
+	float cellSize = 1;
+	float truncation = 1;
+	int res[3] = { 0, 0, 0 };
+	std::vector<float> values;
+	std::vector<SDFShape> shapes;
+	std::vector<bool> alive;    // removed shapes keep their slot so ids stay valid
+	bool dirtyAll = false;
+	std::vector<DirtyBox> dirtyBoxes;
+	int version = 0;
+};
+
+#endif
@@ -0,0 +1,500 @@
+#include "skeletonIO.h"
+#include "bvhIO.h"
+#include "threadPool.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <string.h>
+#include <charconv>
+#include <fstream>
+#include <iterator>
+#include <string_view>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool MappedFile::open(const std::string &path) {
+	close();
+#ifndef _WIN32
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd >= 0) {
+		struct stat info;
+		if (fstat(fd, &info) == 0 && info.st_size > 0) {
+			void *mapped = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (mapped != MAP_FAILED) {
+				mapping = mapped;
+				mappedSize = info.st_size;
+				::close(fd);
+				return true;
+			}
+		}
+		::close(fd);
+	}
+#endif
+	std::ifstream in(path, std::ios::binary);
+	if (!in) return false;
+	buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	return true;
+}
+
+void MappedFile::close() {
+#ifndef _WIN32
+	if (mapping != NULL) munmap(mapping, mappedSize);
+#endif
+	mapping = NULL;
+	mappedSize = 0;
+	buffer.clear();
+}
+
+namespace {
+
+// Walks one line of the buffer, token by token
+//
+struct LineCursor {
+	const char *p;
+	const char *end;    // end of the line (newline excluded)
+
+	void skipSpaces() {
+		while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+	}
+	bool atEnd() {
+		skipSpaces();
+		return p >= end;
+	}
+	std::string_view token() {
+		skipSpaces();
+		const char *start = p;
+		while (p < end && *p != ' ' && *p != '\t' && *p != '\r') p++;
+		return std::string_view(start, p - start);
+	}
+	bool expect(char c) {
+		skipSpaces();
+		if (p < end && *p == c) {
+			p++;
+			return true;
+		}
+		return false;
+	}
+	bool number(float &value) {
+		skipSpaces();
+		if (p < end && *p == '+') p++;  // from_chars doesn't take a leading '+'
+		std::from_chars_result result = std::from_chars(p, end, value);
+		if (result.ec != std::errc()) return false;
+		p = result.ptr;
+		return true;
+	}
+	// <x, y, z>
+	bool vector(glm::vec3 &v) {
+		return expect('<') && number(v.x) && expect(',') && number(v.y) && expect(',') && number(v.z) && expect('>');
+	}
+};
+
+}
+
+bool parseSkeletonText(const char *data, size_t size, SkeletonDesc &out, std::string &error) {
+	const char *p = data;
+	const char *end = data + size;
+
+	size_t lines = 1;
+	for (const char *q = p; (q = (const char *)memchr(q, '\n', end - q)) != NULL; q++) lines++;
+	out.joints.clear();
+	out.joints.reserve(lines);
+
+	// names point into the buffer, so building the index allocates no strings
+	std::unordered_map<std::string_view, int> index;
+	index.reserve(lines);
+
+	for (int lineNumber = 1; p < end; lineNumber++) {
+		const char *newline = (const char *)memchr(p, '\n', end - p);
+		LineCursor cursor = { p, newline != NULL ? newline : end };
+		p = (newline != NULL) ? newline + 1 : end;
+		auto fail = [&](const std::string &message) {
+			error = "line " + std::to_string(lineNumber) + ": " + message;
+			return false;
+		};
+
+		if (cursor.atEnd()) continue; // blank line
+		std::string_view command = cursor.token();
+		if (command != "create") return fail("expected 'create', found '" + std::string(command) + "'");
+
+		JointDesc joint;
+		std::string_view name;
+		while (!cursor.atEnd()) {
+			std::string_view option = cursor.token();
+			if (option == "-joint") {
+				name = cursor.token();
+				if (name.empty()) return fail("-joint needs a name");
+			}
+			else if (option == "-rotate") {
+				if (!cursor.vector(joint.rotation)) return fail("-rotate needs <x, y, z>");
+			}
+			else if (option == "-translate") {
+				if (!cursor.vector(joint.translation)) return fail("-translate needs <x, y, z>");
+			}
+			else if (option == "-min") {
+				if (!cursor.vector(joint.minAngles)) return fail("-min needs <x, y, z>");
+				joint.hasLimits = true;
+			}
+			else if (option == "-max") {
+				if (!cursor.vector(joint.maxAngles)) return fail("-max needs <x, y, z>");
+				joint.hasLimits = true;
+			}
+			else if (option == "-parent") {
+				std::string_view parentName = cursor.token();
+				auto found = index.find(parentName);
+				if (found == index.end()) return fail("parent '" + std::string(parentName) + "' isn't defined above this line");
+				joint.parent = found->second;
+			}
+			else return fail("unknown option '" + std::string(option) + "'");
+		}
+		if (name.empty()) return fail("missing -joint <name>");
+
+		joint.name.assign(name.data(), name.size());
+		index.emplace(name, (int)out.joints.size()); // keeps the first joint of a name
+		out.joints.push_back(std::move(joint));
+	}
+	return true;
+}
+
+bool loadSkeletonText(const std::string &path, SkeletonDesc &out, std::string &error) {
+	MappedFile file;
+	if (!file.open(path)) {
+		error = "can't open " + path;
+		return false;
+	}
+	if (!parseSkeletonText(file.data(), file.size(), out, error)) {
+		error = path + ", " + error;
+		return false;
+	}
+	return true;
+}
+
+void appendNumber(std::string &out, float value) {
+	char digits[32];
+	std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value); // shortest that reads back the same
+	out.append(digits, result.ptr);
+}
+
+namespace {
+
+void appendVector(std::string &out, const glm::vec3 &v) {
+	out += '<';
+	appendNumber(out, v.x);
+	out += ", ";
+	appendNumber(out, v.y);
+	out += ", ";
+	appendNumber(out, v.z);
+	out += '>';
+}
+
+// The whole buffer in one write where the platform lets us
+//
+bool writeFile(const std::string &path, const char *data, size_t size, std::string &error) {
+#ifndef _WIN32
+	int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		error = "can't write " + path;
+		return false;
+	}
+	while (size > 0) {
+		ssize_t written = ::write(fd, data, size);
+		if (written < 0 && errno == EINTR) continue;
+		if (written <= 0) {
+			::close(fd);
+			error = "can't write " + path;
+			return false;
+		}
+		data += written;
+		size -= written;
+	}
+	if (::close(fd) != 0) {
+		error = "can't write " + path;
+		return false;
+	}
+	return true;
+#else
+	std::ofstream out(path, std::ios::binary);
+	if (!out.write(data, size)) {
+		error = "can't write " + path;
+		return false;
+	}
+	return true;
+#endif
+}
+
+}
+
+void writeSkeletonText(const SkeletonDesc &skeleton, std::string &out) {
+	out.reserve(out.size() + skeleton.joints.size() * 96);
+	for (const JointDesc &joint : skeleton.joints) {
+		out += "create -joint ";
+		out += joint.name;
+		out += " -rotate ";
+		appendVector(out, joint.rotation);
+		out += " -translate ";
+		appendVector(out, joint.translation);
+		if (joint.hasLimits) {
+			out += " -min ";
+			appendVector(out, joint.minAngles);
+			out += " -max ";
+			appendVector(out, joint.maxAngles);
+		}
+		if (joint.parent >= 0) {
+			out += " -parent ";
+			out += skeleton.joints[joint.parent].name;
+		}
+		out += '\n';
+	}
+}
+
+bool saveSkeletonText(const std::string &path, const SkeletonDesc &skeleton, std::string &error) {
+	std::string text;
+	writeSkeletonText(skeleton, text);
+	return writeFile(path, text.data(), text.size(), error);
+}
+
+void writeSkeletonBinary(const SkeletonDesc &skeleton, std::string &out) {
+	uint32_t count = (uint32_t)skeleton.joints.size();
+
+	// intern the names first so the size of every section is known up front
+	std::vector<uint32_t> nameOffsets(count);
+	std::unordered_map<std::string_view, uint32_t> interned;
+	interned.reserve(count);
+	uint32_t stringTableSize = 0;
+	bool anyLimits = false;
+	for (uint32_t i = 0; i < count; i++) {
+		const JointDesc &joint = skeleton.joints[i];
+		auto found = interned.emplace(joint.name, stringTableSize);
+		if (found.second) stringTableSize += (uint32_t)joint.name.size() + 1;
+		nameOffsets[i] = found.first->second;
+		anyLimits = anyLimits || joint.hasLimits;
+	}
+
+	SkeletonBinaryHeader header;
+	memcpy(header.magic, "SKEL", 4);
+	header.byteOrder = 0x01020304;
+	header.version = SkeletonBinaryHeader::CurrentVersion;
+	header.jointCount = count;
+	header.stringTableSize = stringTableSize;
+	header.flags = anyLimits ? SkeletonBinaryHeader::HasLimits : 0;
+
+	size_t perJoint = sizeof(uint32_t) + sizeof(int32_t) + 2 * sizeof(glm::vec3);
+	if (anyLimits) perJoint += sizeof(uint32_t) + 2 * sizeof(glm::vec3);
+	size_t start = out.size();
+	out.resize(start + sizeof(header) + count * perJoint + stringTableSize);
+
+	// each section is filled straight into out
+	char *p = &out[start];
+	auto put = [&](const void *value, size_t size) {
+		memcpy(p, value, size);
+		p += size;
+	};
+	put(&header, sizeof(header));
+	put(nameOffsets.data(), count * sizeof(uint32_t));
+	for (const JointDesc &joint : skeleton.joints) put(&joint.parent, sizeof(int32_t));
+	for (const JointDesc &joint : skeleton.joints) put(&joint.rotation, sizeof(glm::vec3));
+	for (const JointDesc &joint : skeleton.joints) put(&joint.translation, sizeof(glm::vec3));
+	if (anyLimits) {
+		for (const JointDesc &joint : skeleton.joints) {
+			uint32_t flag = joint.hasLimits;
+			put(&flag, sizeof(uint32_t));
+		}
+		for (const JointDesc &joint : skeleton.joints) put(&joint.minAngles, sizeof(glm::vec3));
+		for (const JointDesc &joint : skeleton.joints) put(&joint.maxAngles, sizeof(glm::vec3));
+	}
+	for (uint32_t i = 0; i < count; i++) {
+		const std::string &name = skeleton.joints[i].name;
+		memcpy(&out[start + sizeof(header) + count * perJoint + nameOffsets[i]], name.c_str(), name.size() + 1);
+	}
+}
+
+bool saveSkeletonBinary(const std::string &path, const SkeletonDesc &skeleton, std::string &error) {
+	std::string out;
+	writeSkeletonBinary(skeleton, out);
+	return writeFile(path, out.data(), out.size(), error);
+}
+
+bool SkeletonBinaryFile::open(const std::string &path, std::string &error) {
+	arrays = SkeletonBinaryView();
+	if (!file.open(path)) {
+		error = "can't open " + path;
+		return false;
+	}
+	const char *data = file.data();
+	size_t size = file.size();
+	SkeletonBinaryHeader header;
+	if (size < sizeof(header)) {
+		error = path + " is too short for a skeleton header";
+		return false;
+	}
+	memcpy(&header, data, sizeof(header));
+	if (memcmp(header.magic, "SKEL", 4) != 0) {
+		error = path + " isn't a binary skeleton";
+		return false;
+	}
+	if (header.byteOrder != 0x01020304) {
+		error = path + " was written with the other byte order";
+		return false;
+	}
+	if (header.version != SkeletonBinaryHeader::CurrentVersion) {
+		error = path + " is version " + std::to_string(header.version) + ", expected " + std::to_string(SkeletonBinaryHeader::CurrentVersion);
+		return false;
+	}
+
+	size_t count = header.jointCount;
+	size_t perJoint = sizeof(uint32_t) + sizeof(int32_t) + 2 * sizeof(glm::vec3);
+	if (header.flags & SkeletonBinaryHeader::HasLimits) perJoint += sizeof(uint32_t) + 2 * sizeof(glm::vec3);
+	if (count > (size - sizeof(header)) / perJoint || sizeof(header) + count * perJoint + header.stringTableSize != size) {
+		error = path + " is truncated or has the wrong size for " + std::to_string(count) + " joints";
+		return false;
+	}
+
+	const char *p = data + sizeof(header);
+	arrays.jointCount = header.jointCount;
+	arrays.nameOffsets = (const uint32_t *)p;
+	p += count * sizeof(uint32_t);
+	arrays.parents = (const int32_t *)p;
+	p += count * sizeof(int32_t);
+	arrays.rotations = (const glm::vec3 *)p;
+	p += count * sizeof(glm::vec3);
+	arrays.translations = (const glm::vec3 *)p;
+	p += count * sizeof(glm::vec3);
+	if (header.flags & SkeletonBinaryHeader::HasLimits) {
+		arrays.hasLimits = (const uint32_t *)p;
+		p += count * sizeof(uint32_t);
+		arrays.minAngles = (const glm::vec3 *)p;
+		p += count * sizeof(glm::vec3);
+		arrays.maxAngles = (const glm::vec3 *)p;
+		p += count * sizeof(glm::vec3);
+	}
+	arrays.strings = p;
+
+	// Everything the scene builder will trust
+	if (header.stringTableSize > 0 && arrays.strings[header.stringTableSize - 1] != '\0') {
+		error = path + ": string table isn't terminated";
+		return false;
+	}
+	for (size_t i = 0; i < count; i++) {
+		if (arrays.nameOffsets[i] >= header.stringTableSize) {
+			error = path + ": joint " + std::to_string(i) + " has a name outside the string table";
+			return false;
+		}
+		if (arrays.parents[i] < -1 || arrays.parents[i] >= (int32_t)i) {
+			error = path + ": joint " + std::to_string(i) + " has parent " + std::to_string(arrays.parents[i]) + ", which isn't an earlier joint";
+			return false;
+		}
+	}
+	return true;
+}
+
+void binaryViewToDesc(const SkeletonBinaryView &view, SkeletonDesc &out) {
+	out.joints.resize(view.jointCount);
+	for (uint32_t i = 0; i < view.jointCount; i++) {
+		JointDesc &joint = out.joints[i];
+		joint.name = view.name(i);
+		joint.parent = view.parents[i];
+		joint.rotation = view.rotations[i];
+		joint.translation = view.translations[i];
+		joint.hasLimits = view.hasLimits != NULL && view.hasLimits[i];
+		if (view.hasLimits != NULL) {
+			joint.minAngles = view.minAngles[i];
+			joint.maxAngles = view.maxAngles[i];
+		}
+	}
+}
+
+bool loadSkeletonBinary(const std::string &path, SkeletonDesc &out, std::string &error) {
+	SkeletonBinaryFile file;
+	if (!file.open(path, error)) return false;
+	binaryViewToDesc(file.view(), out);
+	return true;
+}
+
+bool convertSkeletonTextToBinary(const std::string &textPath, const std::string &binaryPath, std::string &error) {
+	SkeletonDesc skeleton;
+	return loadSkeletonText(textPath, skeleton, error) && saveSkeletonBinary(binaryPath, skeleton, error);
+}
+
+bool convertSkeletonBinaryToText(const std::string &binaryPath, const std::string &textPath, std::string &error) {
+	SkeletonDesc skeleton;
+	return loadSkeletonBinary(binaryPath, skeleton, error) && saveSkeletonText(textPath, skeleton, error);
+}
+
+bool hasExtension(const std::string &path, const char *ext) {
+	size_t length = strlen(ext);
+	if (path.size() < length) return false;
+	const char *end = path.c_str() + path.size() - length;
+	for (size_t i = 0; i < length; i++) {
+		if (tolower((unsigned char)end[i]) != tolower((unsigned char)ext[i])) return false;
+	}
+	return true;
+}
+
+bool SkeletonWriter::start(const std::string &path_, SkeletonDesc &&skeleton) {
+	if (busy) return false;
+	wait();
+	snapshot = std::move(skeleton);
+	path = path_;
+	busy = true;
+	reported = false;
+	worker = std::thread([this] {
+		buffer.clear(); // keeps its capacity
+		if (isSkeletonBinaryPath(path)) writeSkeletonBinary(snapshot, buffer);
+		else writeSkeletonText(snapshot, buffer);
+		ok = writeFile(path, buffer.data(), buffer.size(), error);
+		busy = false;
+	});
+	return true;
+}
+
+bool SkeletonWriter::poll(bool &succeeded, std::string &message) {
+	if (busy || reported) return false;
+	wait();
+	reported = true;
+	succeeded = ok;
+	message = ok ? "Saved " + std::to_string(snapshot.joints.size()) + " joints to " + path : "Save failed: " + error;
+	return true;
+}
+
+bool SkeletonLoader::start(const std::vector<std::string> &paths) {
+	if (busy) return false;
+	wait();
+	results.clear();
+	results.resize(paths.size());
+	for (size_t i = 0; i < paths.size(); i++) results[i].path = paths[i];
+	total = (int)paths.size();
+	done = 0;
+	busy = true;
+	reported = false;
+	worker = std::thread([this] {
+		ThreadPool::shared().parallelFor((int)results.size(), 1, [this](int begin, int end) {
+			for (int i = begin; i < end; i++) {
+				LoadedSkeleton &result = results[i];
+				if (isSkeletonBinaryPath(result.path)) {
+					result.binary.reset(new SkeletonBinaryFile());
+					result.ok = result.binary->open(result.path, result.error);
+					if (!result.ok) result.binary.reset();
+				}
+				else if (isBVHPath(result.path)) result.ok = loadBVH(result.path, result.skeleton, result.motion, result.error);
+				else result.ok = loadSkeletonText(result.path, result.skeleton, result.error);
+				done++;
+			}
+		});
+		busy = false;
+	});
+	return true;
+}
+
+bool SkeletonLoader::poll(std::vector<LoadedSkeleton> &loaded) {
+	if (busy || reported) return false;
+	wait();
+	reported = true;
+	loaded = std::move(results);
+	results.clear();
+	return true;
+}
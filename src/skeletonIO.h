@@ -0,0 +1,240 @@
+#ifndef _SKELETONIO_H_
+#define _SKELETONIO_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "glm/glm.hpp"
+
+/*
+ * Reading and writing skeleton files without touching the scene.
+ *
+ * A file is parsed into a SkeletonDesc - a flat list of joints with parents stored as
+ * indices - and ofApp builds the scene from that in one go.  Text files look like
+ *
+ *   create -joint <name> -rotate <x, y, z> -translate <x, y, z> [-min <x, y, z> -max <x, y, z>] [-parent <name>]
+ *
+ * one joint per line, parents before their children.  If two joints share a name,
+ * -parent means the first of them (same as the old scene lookup did).
+ *
+ * Binary files (.skb) hold the same thing as flat arrays, so loading is a matter of
+ * mapping the file and pointing at them:
+ *
+ *   SkeletonBinaryHeader
+ *   uint32 nameOffsets[jointCount]    into the string table
+ *   int32  parents[jointCount]        -1 for roots, otherwise an earlier joint
+ *   float  rotations[jointCount * 3]
+ *   float  translations[jointCount * 3]
+ *   -- if flags & HasLimits --
+ *   uint32 hasLimits[jointCount]
+ *   float  minAngles[jointCount * 3]
+ *   float  maxAngles[jointCount * 3]
+ *   char   strings[stringTableSize]   NUL terminated names, each distinct name stored once
+ *
+ * Everything is 4-byte little-endian.  Text and binary convert both ways without
+ * losing anything: numbers are written as the shortest text that reads back to the
+ * same float.  (Parents are by index in binary but by name in text, so a skeleton
+ * whose child hangs off the second of two same-named joints can't survive text.)
+ */
+
+struct JointDesc {
+	std::string name;
+	glm::vec3 rotation = glm::vec3(0, 0, 0);     // Euler degrees
+	glm::vec3 translation = glm::vec3(0, 0, 0);  // relative to the parent
+	int parent = -1;                             // index into SkeletonDesc::joints, -1 for a root
+	bool hasLimits = false;
+	glm::vec3 minAngles = glm::vec3(-180, -180, -180);
+	glm::vec3 maxAngles = glm::vec3(180, 180, 180);
+};
+
+struct SkeletonDesc {
+	std::vector<JointDesc> joints;
+};
+
+// Per-frame joint transforms for a SkeletonDesc, e.g. from motion capture
+//
+struct SkeletonMotion {
+	int numJoints = 0;
+	int numFrames = 0;
+	float frameTime = 0;                   // seconds
+	std::vector<glm::vec3> rotations;      // numFrames x numJoints, Euler degrees (YXZ)
+	std::vector<glm::vec3> translations;   // numFrames x numJoints, relative to the parent
+
+	const glm::vec3 &rotation(int frame, int joint) const { return rotations[(size_t)frame * numJoints + joint]; }
+	const glm::vec3 &translation(int frame, int joint) const { return translations[(size_t)frame * numJoints + joint]; }
+};
+
+// Parse the text format from memory.  On failure returns false with
+// "line N: what was wrong" in error, and leaves out in an unspecified state.
+//
+bool parseSkeletonText(const char *data, size_t size, SkeletonDesc &out, std::string &error);
+
+// Same, from a file (memory mapped where the platform allows)
+//
+bool loadSkeletonText(const std::string &path, SkeletonDesc &out, std::string &error);
+
+// Append the shortest text that reads back as exactly value
+//
+void appendNumber(std::string &out, float value);
+
+// Append the text format to out, one buffer for the whole skeleton
+//
+void writeSkeletonText(const SkeletonDesc &skeleton, std::string &out);
+bool saveSkeletonText(const std::string &path, const SkeletonDesc &skeleton, std::string &error);
+
+//  Read-only view of a whole file: memory mapped on POSIX systems, read into a
+//  buffer everywhere else (or if mapping fails)
+//
+class MappedFile {
+public:
+	MappedFile() { }
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+	~MappedFile() { close(); }
+
+	bool open(const std::string &path);
+	void close();
+	const char *data() const { return mapping != NULL ? (const char *)mapping : buffer.data(); }
+	size_t size() const { return mapping != NULL ? mappedSize : buffer.size(); }
+
+private:
+	void *mapping = NULL;
+	size_t mappedSize = 0;
+	std::vector<char> buffer;
+};
+
+struct SkeletonBinaryHeader {
+	char magic[4];            // "SKEL"
+	uint32_t byteOrder;       // 0x01020304 as written
+	uint32_t version;
+	uint32_t jointCount;
+	uint32_t stringTableSize;
+	uint32_t flags;
+
+	static const uint32_t CurrentVersion = 1;
+	static const uint32_t HasLimits = 1;
+};
+
+// The arrays of a mapped binary skeleton, in place
+//
+struct SkeletonBinaryView {
+	uint32_t jointCount = 0;
+	const uint32_t *nameOffsets = NULL;
+	const int32_t *parents = NULL;
+	const glm::vec3 *rotations = NULL;
+	const glm::vec3 *translations = NULL;
+	const uint32_t *hasLimits = NULL;      // NULL if no joint has limits
+	const glm::vec3 *minAngles = NULL;
+	const glm::vec3 *maxAngles = NULL;
+	const char *strings = NULL;
+
+	const char *name(int i) const { return strings + nameOffsets[i]; }
+};
+
+// A binary skeleton file kept mapped for as long as this lives
+//
+class SkeletonBinaryFile {
+public:
+	// Maps and validates the file; the view points straight into the mapping
+	bool open(const std::string &path, std::string &error);
+	const SkeletonBinaryView &view() const { return arrays; }
+
+private:
+	MappedFile file;
+	SkeletonBinaryView arrays;
+};
+
+// Whole-skeleton conversions.  The save functions write the file in one go.
+//
+void writeSkeletonBinary(const SkeletonDesc &skeleton, std::string &out);
+bool saveSkeletonBinary(const std::string &path, const SkeletonDesc &skeleton, std::string &error);
+void binaryViewToDesc(const SkeletonBinaryView &view, SkeletonDesc &out);
+bool loadSkeletonBinary(const std::string &path, SkeletonDesc &out, std::string &error);
+
+// Text <-> binary on disk
+//
+bool convertSkeletonTextToBinary(const std::string &textPath, const std::string &binaryPath, std::string &error);
+bool convertSkeletonBinaryToText(const std::string &binaryPath, const std::string &textPath, std::string &error);
+
+// Case-insensitive test of a path's extension, ext including the dot (".skb")
+//
+bool hasExtension(const std::string &path, const char *ext);
+
+// True for paths that should be read and written as binary (.skb)
+//
+inline bool isSkeletonBinaryPath(const std::string &path) { return hasExtension(path, ".skb"); }
+
+//  Saves a snapshot of a skeleton on its own thread so a big rig doesn't stall the
+//  frame.  One save runs at a time, and the output buffer is kept from one save to the
+//  next so it's only grown once.
+//
+class SkeletonWriter {
+public:
+	~SkeletonWriter() { wait(); }
+
+	// Start writing skeleton to path (binary if it ends in .skb).  Returns false, and
+	// leaves skeleton alone, if the last save is still going.
+	bool start(const std::string &path, SkeletonDesc &&skeleton);
+	bool isBusy() const { return busy; }
+
+	// Call from the main thread: true once for every save that has finished, with
+	// whether it worked and a line to report
+	bool poll(bool &succeeded, std::string &message);
+	void wait() { if (worker.joinable()) worker.join(); }
+
+private:
+	std::thread worker;
+	std::atomic<bool> busy{ false };
+	bool reported = true;
+
+	// only touched by the worker while busy
+	SkeletonDesc snapshot;
+	std::string path;
+	std::string buffer;
+	bool ok = false;
+	std::string error;
+};
+
+// One file's worth of SkeletonLoader output
+//
+struct LoadedSkeleton {
+	std::string path;
+	bool ok = false;
+	std::string error;
+	SkeletonDesc skeleton;                      // text and BVH files
+	SkeletonMotion motion;                      // BVH files
+	std::unique_ptr<SkeletonBinaryFile> binary; // binary files, still mapped so they can be built from in place
+};
+
+//  Reads and parses a batch of skeleton files off the main thread, spread over the
+//  shared thread pool.  Nothing is handed back until the whole batch is done, so the
+//  caller can swap them all into the scene at once.
+//
+class SkeletonLoader {
+public:
+	~SkeletonLoader() { wait(); }
+
+	// Returns false if the last batch is still loading
+	bool start(const std::vector<std::string> &paths);
+	bool isBusy() const { return busy; }
+	int numFiles() const { return total; }
+	int numDone() const { return done; }
+
+	// Call from the main thread: true once per finished batch, with a result per file
+	// (in the order given to start)
+	bool poll(std::vector<LoadedSkeleton> &loaded);
+	void wait() { if (worker.joinable()) worker.join(); }
+
+private:
+	std::thread worker;
+	std::atomic<bool> busy{ false };
+	std::atomic<int> done{ 0 };
+	int total = 0;
+	bool reported = true;
+	std::vector<LoadedSkeleton> results; // only touched by the workers while busy
+};
+
+#endif
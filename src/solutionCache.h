@@ -0,0 +1,111 @@
+#ifndef _SOLUTIONCACHE_H_
+#define _SOLUTIONCACHE_H_
+
+#include <math.h>
+#include <stdint.h>
+#include <list>
+#include <iterator>
+#include <vector>
+#include <unordered_map>
+#include "glm/glm.hpp"
+
+/*
+ * Bounded cache of converged IK poses, keyed by where the target was (in the frame
+ * the chain's base hangs off).  Targets are quantized into cells of a spatial hash,
+ * one pose per cell; a lookup returns the closest stored target from the cell and its
+ * 26 neighbours so a new solve can start from a pose that already got near there.
+ * The least recently used cell is recycled once the cache is full.
+ */
+
+class IKSolutionCache {
+public:
+	struct Entry {
+		uint64_t key;
+		glm::vec3 target;
+		std::vector<float> angles;
+	};
+
+	IKSolutionCache(float cellSize_ = 0.25f, int capacity_ = 256) {
+		cellSize = cellSize_;
+		capacity = capacity_;
+	}
+
+	// Closest cached solution near the target, or NULL.  Counts towards the hit rate.
+	//
+	const Entry *lookup(const glm::vec3 &target) {
+		int cx, cy, cz;
+		cellOf(target, cx, cy, cz);
+		std::list<Entry>::iterator best = entries.end();
+		float bestDist = 0;
+		for (int dz = -1; dz <= 1; dz++) for (int dy = -1; dy <= 1; dy++) for (int dx = -1; dx <= 1; dx++) {
+			auto found = index.find(makeKey(cx + dx, cy + dy, cz + dz));
+			if (found == index.end()) continue;
+			float dist = glm::distance(found->second->target, target);
+			if (best == entries.end() || dist < bestDist) {
+				best = found->second;
+				bestDist = dist;
+			}
+		}
+		if (best == entries.end()) {
+			misses++;
+			return NULL;
+		}
+		hits++;
+		entries.splice(entries.begin(), entries, best); // most recently used
+		return &entries.front();
+	}
+
+	void insert(const glm::vec3 &target, const float *angles, int numAngles) {
+		int cx, cy, cz;
+		cellOf(target, cx, cy, cz);
+		uint64_t key = makeKey(cx, cy, cz);
+
+		auto found = index.find(key);
+		if (found != index.end()) {
+			entries.splice(entries.begin(), entries, found->second);
+		}
+		else if ((int)entries.size() >= capacity) {
+			// recycle the least recently used entry (and its angle buffer)
+			index.erase(entries.back().key);
+			entries.splice(entries.begin(), entries, std::prev(entries.end()));
+			index[key] = entries.begin();
+		}
+		else {
+			entries.push_front(Entry());
+			index[key] = entries.begin();
+		}
+		Entry &entry = entries.front();
+		entry.key = key;
+		entry.target = target;
+		entry.angles.assign(angles, angles + numAngles);
+	}
+
+	void clear() {
+		entries.clear();
+		index.clear();
+	}
+
+	float hitRate() const { return (hits + misses) ? (float)hits / (hits + misses) : 0; }
+	int size() const { return (int)entries.size(); }
+
+	int hits = 0;
+	int misses = 0;
+
+private:
+	void cellOf(const glm::vec3 &p, int &x, int &y, int &z) const {
+		x = (int)floorf(p.x / cellSize);
+		y = (int)floorf(p.y / cellSize);
+		z = (int)floorf(p.z / cellSize);
+	}
+	static uint64_t makeKey(int x, int y, int z) {
+		const uint64_t mask = (1 << 21) - 1;
+		return ((uint64_t)(x & mask) << 42) | ((uint64_t)(y & mask) << 21) | (uint64_t)(z & mask);
+	}
+
+	float cellSize;
+	int capacity;
+	std::list<Entry> entries;  // front = most recently used
+	std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+};
+
+#endif
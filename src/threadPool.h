@@ -0,0 +1,129 @@
+#ifndef _THREADPOOL_H_
+#define _THREADPOOL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Small fixed-size worker pool.  parallelFor() cuts a range into chunks, hands them
+ * to the workers and works on them from the calling thread too, returning once every
+ * chunk is done.  Ranges that fit in one chunk just run inline, so short jobs never
+ * pay for a thread hop.
+ */
+
+class ThreadPool {
+public:
+	ThreadPool(int numThreads = std::max(1u, std::thread::hardware_concurrency()) - 1) {
+		for (int i = 0; i < numThreads; i++) {
+			workers.emplace_back([this] { workerLoop(); });
+		}
+	}
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (auto &worker : workers) worker.join();
+	}
+
+	static ThreadPool &shared() {
+		static ThreadPool pool;
+		return pool;
+	}
+
+	int numThreads() const { return (int)workers.size() + 1; } // workers + caller
+
+	// fn(begin, end) over [0, count) in chunks of at least minChunk.  The caller works
+	// through chunks as well, so this is safe to call from inside a pool job.
+	//
+	void parallelFor(int count, int minChunk, const std::function<void(int, int)> &fn) {
+		int numChunks = std::min(numThreads() * 4, (count + minChunk - 1) / std::max(minChunk, 1));
+		if (numChunks <= 1 || workers.empty()) {
+			if (count > 0) fn(0, count);
+			return;
+		}
+
+		// Shared so a helper that only gets scheduled after we've returned finds no chunks
+		// left and leaves without touching fn
+		auto range = std::make_shared<Range>();
+		range->fn = fn;
+		range->count = count;
+		range->numChunks = numChunks;
+		range->chunkSize = (count + numChunks - 1) / numChunks;
+		range->chunksLeft = numChunks;
+
+		int helpers = std::min((int)workers.size(), numChunks - 1);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (int i = 0; i < helpers; i++) jobs.push_back([range] { range->run(); });
+		}
+		wake.notify_all();
+
+		range->run();
+		std::unique_lock<std::mutex> lock(range->doneMutex);
+		range->done.wait(lock, [&] { return range->chunksLeft == 0; });
+	}
+
+	// Run fn on a worker; the caller is responsible for waiting on whatever fn signals
+	//
+	void submit(std::function<void()> fn) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			jobs.push_back(std::move(fn));
+		}
+		wake.notify_one();
+	}
+
+private:
+	struct Range {
+		std::function<void(int, int)> fn;
+		int count, numChunks, chunkSize;
+		std::atomic<int> nextChunk{ 0 };
+		std::atomic<int> chunksLeft{ 0 };
+		std::mutex doneMutex;
+		std::condition_variable done;
+
+		void run() {
+			int c;
+			while ((c = nextChunk++) < numChunks) {
+				int begin = c * chunkSize;
+				int end = std::min(count, begin + chunkSize);
+				if (begin < end) fn(begin, end);
+				if (--chunksLeft == 0) {
+					std::lock_guard<std::mutex> lock(doneMutex);
+					done.notify_all();
+				}
+			}
+		}
+	};
+
+	void workerLoop() {
+		for (;;) {
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+				if (stopping && jobs.empty()) return;
+				job = std::move(jobs.front());
+				jobs.pop_front();
+			}
+			job();
+		}
+	}
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> jobs;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping = false;
+};
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef _TRANSFORM_H_
+#define _TRANSFORM_H_
+
+#include "glm/gtc/quaternion.hpp"
+#include "glm/gtx/quaternion.hpp"
+
+/*
+ * Compact affine transform: rotation (quaternion), translation and scale.
+ *
+ * A point p is mapped to  translation + rotation * (scale * p).  The rotate pivot
+ * of a SceneObject is folded into the translation when the transform is built
+ * (see fromTRS), so compose, inverse and transformPoint never go through a
+ * general 4x4 matrix.  Use toMat4() only when handing the transform to OF for drawing.
+ *
+ * Scale is kept per axis, but compose() and inverse() are only exact for uniform
+ * scale - a rotated non-uniform scale is a shear, which TRS can't hold.
+ */
+
+class Transform {
+public:
+	Transform() { }
+	Transform(const glm::quat &r, const glm::vec3 &t, const glm::vec3 &s = glm::vec3(1, 1, 1)) {
+		rotation = r;
+		translation = t;
+		scale = s;
+	}
+
+	// Equivalent of  T(trans) * T(pivot) * R * T(-pivot) * S  (the old getLocalMatrix() order)
+	//
+	static Transform fromTRS(const glm::vec3 &trans, const glm::quat &rot, const glm::vec3 &sc, const glm::vec3 &pivot) {
+		return Transform(rot, trans + pivot - rot * pivot, sc);
+	}
+
+	// Same rotation as glm::eulerAngleYXZ (yaw, pitch, roll), angles in degrees
+	//
+	static glm::quat rotationFromEuler(const glm::vec3 &degrees) {
+		return glm::angleAxis(glm::radians(degrees.y), glm::vec3(0, 1, 0)) *
+			glm::angleAxis(glm::radians(degrees.x), glm::vec3(1, 0, 0)) *
+			glm::angleAxis(glm::radians(degrees.z), glm::vec3(0, 0, 1));
+	}
+
+	glm::vec3 transformPoint(const glm::vec3 &p) const {
+		return translation + rotation * (scale * p);
+	}
+	glm::vec3 transformVector(const glm::vec3 &v) const {
+		return rotation * (scale * v);
+	}
+
+	// (a * b) applies b first, then a - same order as matrix concatenation
+	//
+	Transform operator*(const Transform &b) const {
+		return Transform(rotation * b.rotation, transformPoint(b.translation), scale * b.scale);
+	}
+	Transform &operator*=(const Transform &b) {
+		*this = *this * b;
+		return *this;
+	}
+
+	bool operator==(const Transform &b) const {
+		return rotation == b.rotation && translation == b.translation && scale == b.scale;
+	}
+	bool operator!=(const Transform &b) const { return !(*this == b); }
+
+	Transform inverse() const {
+		glm::quat rInv = glm::conjugate(rotation);
+		glm::vec3 sInv = glm::vec3(1, 1, 1) / scale;
+		return Transform(rInv, -(sInv * (rInv * translation)), sInv);
+	}
+
+	glm::mat4 toMat4() const {
+		glm::mat4 m = glm::mat4_cast(rotation);
+		m[0] *= scale.x;
+		m[1] *= scale.y;
+		m[2] *= scale.z;
+		m[3] = glm::vec4(translation, 1.0f);
+		return m;
+	}
+
+	glm::quat rotation = glm::quat(1, 0, 0, 0);
+	glm::vec3 translation = glm::vec3(0, 0, 0);
+	glm::vec3 scale = glm::vec3(1, 1, 1);
+};
+
+#endif
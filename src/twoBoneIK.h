@@ -0,0 +1,126 @@
+#ifndef _TWOBONEIK_H_
+#define _TWOBONEIK_H_
+
+#include <math.h>
+#include "ikChain.h"
+
+/*
+ * Closed-form solver for the classic two-bone chain (shoulder-elbow-wrist,
+ * hip-knee-ankle).  In our locked-axis rigs that is a base joint turning about Y,
+ * two hinges about Z, and the end joint:
+ *
+ *      Y (yaw)  ->  Z (shoulder)  ->  Z (elbow)  ->  end
+ *
+ * The Z hinges keep the arm in one plane, so the yaw is whatever puts the target in
+ * that plane, and the two hinge angles come from the law of cosines.  That gives up
+ * to four poses (two yaws x elbow up/down); we keep the one that gets closest to the
+ * target, breaking ties by how close the elbow lands to the pole point.  Poses that
+ * break a joint limit only win when no pose within the limits gets as close.
+ */
+
+struct TwoBoneResult {
+	float angles[3];   // yaw, shoulder, elbow (degrees); the end joint's angle is untouched
+	bool reachable;    // exact - false means angles hold the closest (fully stretched/folded) pose
+	float error;       // distance from end joint to target with these angles
+	bool withinLimits; // false if only poses that break a joint limit get this close - solve it iteratively instead
+};
+
+// True if the chain has the Y, Z, Z, end shape with no scale or pivot to worry about
+//
+inline bool isTwoBoneChain(const IKChainSolver &chain) {
+	if (chain.size() != 4) return false;
+	if (chain.getLink(0).axis != JointAxis::Y || chain.getLink(1).axis != JointAxis::Z || chain.getLink(2).axis != JointAxis::Z) return false;
+	for (int i = 0; i < 4; i++) {
+		const ChainLink &link = chain.getLink(i);
+		if (link.scale != glm::vec3(1, 1, 1) || link.pivot != glm::vec3(0, 0, 0)) return false;
+	}
+	glm::vec3 t2 = chain.getLink(2).position, t3 = chain.getLink(3).position;
+	return (glm::length(glm::vec2(t2.x, t2.y)) > 1e-6f && glm::length(glm::vec2(t3.x, t3.y)) > 1e-6f);
+}
+
+inline TwoBoneResult solveTwoBone(const IKChainSolver &chain, const Transform &base, const glm::vec3 &target, const glm::vec3 &pole) {
+	const float eps = 1e-5f;
+	const float tieTolerance = 1e-3f;
+	glm::vec3 t0 = chain.getLink(0).position;
+	glm::vec3 t1 = chain.getLink(1).position;
+	glm::vec3 t2 = chain.getLink(2).position;
+	glm::vec3 t3 = chain.getLink(3).position;
+
+	// target relative to the base joint, before its yaw
+	glm::vec3 d = base.inverse().transformPoint(target) - t0;
+
+	// Z hinges never change z, so after the yaw the target must sit at this depth
+	float zc = t1.z + t2.z + t3.z;
+	float r = sqrtf(d.x * d.x + d.z * d.z);
+	bool yawReachable = fabsf(zc) <= r + eps;
+	float phi = atan2f(d.x, d.z);
+	float yawOffset = (r > eps) ? acosf(glm::clamp(zc / r, -1.0f, 1.0f)) : 0;
+	float planarX = sqrtf(fmaxf(r * r - zc * zc, 0));
+
+	float l1 = glm::length(glm::vec2(t2.x, t2.y));
+	float l2 = glm::length(glm::vec2(t3.x, t3.y));
+	float alpha2 = atan2f(t2.y, t2.x);
+	float alpha3 = atan2f(t3.y, t3.x);
+
+	// Best pose overall, and best that keeps to the limits
+	TwoBoneResult best, bestLegal;
+	float bestPoleDist = 0, bestLegalPoleDist = 0;
+	bool haveBest = false, haveLegal = false;
+	auto better = [tieTolerance](const TwoBoneResult &res, float poleDist, const TwoBoneResult &than, float thanPoleDist) {
+		return res.error < than.error - tieTolerance || (res.error < than.error + tieTolerance && poleDist < thanPoleDist);
+	};
+	for (int yawSide = 0; yawSide < 2; yawSide++) {
+		float yaw = (yawSide == 0) ? phi + yawOffset : phi - yawOffset;
+		float qx = (yawSide == 0) ? -planarX : planarX;
+
+		// planar problem: reach w from the shoulder with links l1, l2
+		glm::vec2 w(qx - t1.x, d.y - t1.y);
+		float wLen = glm::length(w);
+		float cosDelta = (wLen * wLen - l1 * l1 - l2 * l2) / (2 * l1 * l2);
+		bool planarReachable = (cosDelta >= -1 - eps && cosDelta <= 1 + eps);
+		float delta = acosf(glm::clamp(cosDelta, -1.0f, 1.0f));
+
+		for (int bend = 0; bend < 2; bend++) {
+			float del = (bend == 0) ? delta : -delta;
+			float theta1 = atan2f(w.y, w.x) - atan2f(l2 * sinf(del), l1 + l2 * cosf(del));
+
+			TwoBoneResult res;
+			res.angles[0] = glm::degrees(yaw);
+			res.angles[1] = glm::degrees(theta1 - alpha2);
+			res.angles[2] = glm::degrees(del + alpha2 - alpha3);
+			res.reachable = yawReachable && planarReachable;
+
+			// score it with the real chain
+			Transform sim = base;
+			composeAxisRotation(JointAxis::Y, sim, t0, res.angles[0], glm::vec3(1, 1, 1), glm::vec3(0, 0, 0));
+			composeAxisRotation(JointAxis::Z, sim, t1, res.angles[1], glm::vec3(1, 1, 1), glm::vec3(0, 0, 0));
+			glm::vec3 elbow = sim.transformPoint(t2);
+			composeAxisRotation(JointAxis::Z, sim, t2, res.angles[2], glm::vec3(1, 1, 1), glm::vec3(0, 0, 0));
+			res.error = glm::distance(sim.transformPoint(t3), target);
+			float poleDist = glm::distance(elbow, pole);
+
+			// same pose, but with each angle wound to the turn nearest where the joint is now
+			res.withinLimits = true;
+			for (int i = 0; i < 3; i++) {
+				float current = chain.getAngle(i);
+				res.angles[i] = current + remainderf(res.angles[i] - current, 360.0f);
+				if (chain.getLink(i).clampAngle(res.angles[i]) != res.angles[i]) res.withinLimits = false;
+			}
+
+			if (!haveBest || better(res, poleDist, best, bestPoleDist)) {
+				best = res;
+				bestPoleDist = poleDist;
+				haveBest = true;
+			}
+			if (res.withinLimits && (!haveLegal || better(res, poleDist, bestLegal, bestLegalPoleDist))) {
+				bestLegal = res;
+				bestLegalPoleDist = poleDist;
+				haveLegal = true;
+			}
+		}
+	}
+	// A legal pose that falls short of one that breaks a limit is left to the iterative solver
+	return (haveLegal && bestLegal.error < best.error + tieTolerance) ? bestLegal : best;
+}
+
+#endif
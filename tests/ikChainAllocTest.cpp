@@ -0,0 +1,83 @@
+//
+//  Checks that IKChain::step() never allocates, for the fixed-length chains and the
+//  runtime-sized fallback, with every optimizer, with and without an obstacle field.
+//
+//  Every global operator new is counted while `counting` is set; the chains, the field
+//  and everything else are set up before that.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+#include "ikChain.h"
+
+static bool counting = false;
+static long allocations = 0;
+
+void *operator new(size_t size) {
+	if (counting) allocations++;
+	void *p = malloc(size ? size : 1);
+	if (p == NULL) throw std::bad_alloc();
+	return p;
+}
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+static const int numSteps = 200;
+
+// Returns the number of allocations made by numSteps steps of a fresh chain
+static long countStepAllocations(int numJoints, IKOptimizer optimizer, const SignedDistanceField *obstacles) {
+	std::unique_ptr<IKChainSolver> chain = makeIKChain(numJoints);
+	for (int i = 0; i < numJoints; i++) {
+		ChainLink link;
+		link.position = glm::vec3(0, 1, 0);
+		link.axis = (i == 0) ? JointAxis::Y : JointAxis::Z;
+		link.minAngle = -120;
+		link.maxAngle = 120;
+		chain->setLink(i, link, 10);
+	}
+	IKStepParams params = { 100, 5, 0.001f, optimizer };
+	params.obstacles = obstacles;
+	Transform base;
+	glm::vec3 target(numJoints * 0.5f, numJoints * 0.3f, 0.2f);
+
+	allocations = 0;
+	counting = true;
+	for (int s = 0; s < numSteps; s++) {
+		if (!chain->step(base, target, params)) chain->resetOptimizer();
+	}
+	counting = false;
+	return allocations;
+}
+
+int main() {
+	SignedDistanceField field;
+	field.setup(glm::vec3(-15, -3, -15), glm::vec3(15, 15, 15), 0.5, 2);
+	SDFShape sphere;
+	sphere.type = SDFShape::Sphere;
+	sphere.transform = Transform(glm::quat(1, 0, 0, 0), glm::vec3(1.5, 2, 0));
+	sphere.size = glm::vec3(0.75, 0, 0);
+	field.addShape(sphere);
+	field.rebuild();
+
+	const int lengths[] = { 2, 3, 4, 7, 10, 40 }; // 10 and 40 are runtime-sized
+	const char *optimizers[] = { "fixed", "momentum", "adam" };
+	int failures = 0;
+	for (int numJoints : lengths) {
+		for (int o = 0; o < 3; o++) {
+			for (int withObstacles = 0; withObstacles < 2; withObstacles++) {
+				long count = countStepAllocations(numJoints, (IKOptimizer)o, withObstacles ? &field : NULL);
+				if (count != 0) {
+					printf("FAIL %d joints, %s%s: %ld allocations in %d steps\n", numJoints, optimizers[o],
+						withObstacles ? ", obstacles" : "", count, numSteps);
+					failures++;
+				}
+			}
+		}
+	}
+	if (failures == 0) printf("ok: no allocations in IKChain::step\n");
+	return failures == 0 ? 0 : 1;
+}